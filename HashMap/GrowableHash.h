@@ -0,0 +1,976 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <new>
+#include "Hash.h"
+
+//! \brief Hash-map with heap allocated storage, whose capacity grows online
+//! \details Map is a sequence of generations, each a Hash with twice the capacity of the previous one. Items are
+//!			 always added to the newest generation; when it is full, the adding thread installs the next generation
+//!			 with a single CAS (threads racing to grow discard their own table) and continues there. Lookups never
+//!			 wait for the growth.
+//!
+//!			 Older generations are emptied incrementally by the callers:
+//!			 * PARALLEL_INSERT_TAKE: Items are not copied, old generations drain as items are taken. Draining
+//!			   generations are checked cooperatively by Add and Take callers, a few buckets per call, and once a
+//!			   generation is empty, and no NodeHandle of Extract holds one of its nodes, it is retired and skipped by
+//!			   lookups.
+//!			 * Read modes: Add and Read callers copy the buckets of the previous generation to the newest one,
+//!			   GROWABLE_COPY_STEP buckets per call, and the previous generation is retired once all are copied.
+//!			   A key is read from the previous generation, until the buckets of both its candidates are copied, so
+//!			   lookups visit a single generation. An Add copies the buckets of its key first, so the newest generation
+//!			   holds either all items of the key or just copies, which readers ignore. The Add waits, if another
+//!			   thread is copying the same bucket. Capacity of the previous generation is reserved for the copies, adds
+//!			   beyond it complete the copy first. The map grows again only after the copy is complete, i.e. at most
+//!			   two generations are live. A bucket, which cannot be copied (nodes are stuck in the magazines of other
+//!			   threads), stays in the previous generation, and adds of its keys fail.
+//!
+//!			 Operations pin an epoch domain of the map, retired generations are freed once no operation can use them.
+//! \tparam _Alloc	Must be a HeapAllocator, bucket size and magazines are applied to every generation
+template <typename K,
+          typename V,
+          typename _Alloc = HeapAllocator<>,
+          MapMode OP_MODE = DefaultModeSelector<K, _Alloc>::MODE,
+          BucketPlacement PLACEMENT = BucketPlacement::SINGLE,
+          typename _Hasher = DefaultHasher<K>>
+class GrowableHash
+{
+	typedef typename std::integral_constant<MapMode, OP_MODE> MODE;
+
+	static_assert(std::is_same<typename _Alloc::ALLOCATION_TYPE, ALLOCATION_TYPE_HEAP>::value,
+	              "GrowableHash supports only HeapAllocator");
+	static_assert(!IS_INSERT_READ_FROM_HEAP(OP_MODE),
+	              "PARALLEL_INSERT_READ_GROW_FROM_HEAP is not bounded by capacity, use Hash instead");
+
+public:
+	typedef Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher> Table;
+	typedef typename Table::HashType HashType;
+	typedef typename Table::HashedKey HashedKey;
+
+	//! \brief Owns the node of an item taken with Extract, see Hash::NodeHandle
+	//! \details Keeps the generation of the node from being retired, until the node is returned to it.
+	class NodeHandle
+	{
+	public:
+		inline NodeHandle() noexcept
+		    : m_pHandles(nullptr)
+		{
+		}
+
+		inline NodeHandle(NodeHandle&& other) noexcept
+		    : m_node(std::move(other.m_node))
+		    , m_pHandles(other.m_pHandles)
+		{
+			other.m_pHandles = nullptr;
+		}
+
+		inline NodeHandle& operator=(NodeHandle&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Reset();
+				m_node = std::move(other.m_node);
+				m_pHandles = other.m_pHandles;
+				other.m_pHandles = nullptr;
+			}
+			return *this;
+		}
+
+		inline ~NodeHandle() noexcept
+		{
+			Reset();
+		}
+
+		//! \brief Returns true if the handle owns a node, i.e. the item was found
+		inline explicit operator bool() const noexcept
+		{
+			return bool(m_node);
+		}
+
+		inline V& operator*() const noexcept
+		{
+			return *m_node;
+		}
+
+		inline V* operator->() const noexcept
+		{
+			return m_node.operator->();
+		}
+
+		//! \brief Returns the node to its generation, the handle becomes empty
+		inline void Reset() noexcept
+		{
+			m_node.Reset();
+			if (m_pHandles)
+			{
+				m_pHandles->fetch_sub(1, std::memory_order_release);
+				m_pHandles = nullptr;
+			}
+		}
+
+	private:
+		inline NodeHandle(typename Table::NodeHandle&& node, std::atomic<uint32_t>* pHandles) noexcept
+		    : m_node(std::move(node))
+		    , m_pHandles(pHandles)
+		{
+		}
+
+		typename Table::NodeHandle m_node;
+		std::atomic<uint32_t>* m_pHandles; // Handles of the generation of the node
+
+		friend class GrowableHash;
+
+		NodeHandle(const NodeHandle&) = delete;
+		NodeHandle& operator=(const NodeHandle&) = delete;
+	};
+
+public: // Construction
+	//! \brief
+	//! \param[in] initial_elements	Capacity of the first generation
+	//! \param[in] seed				Seed of the hash function, shared by all generations
+	inline explicit GrowableHash(const uint32_t initial_elements, const uint32_t seed = 0) noexcept;
+
+	inline ~GrowableHash() noexcept;
+
+public: // Access functions
+	//! \brief Adds an item to the newest generation, grows the map if the generation is full
+	//! \return false if the map cannot grow any more (or memory could not be allocated)
+	inline bool Add(const K& k, const V& v) noexcept;
+
+	//! \brief Add, which moves \p k and \p v into the node, see Hash::Add
+	inline bool Add(K&& k, V&& v) noexcept;
+
+	//! \brief
+	//! \param[in]
+	//! \return
+	MODE_NOT_TAKE(MODE) inline const V Read(const K& k) noexcept;
+
+	//! \brief
+	//! \param[in]
+	//! \param[in]
+	//! \return
+	MODE_NOT_TAKE(MODE) inline bool Read(const K& k, V& v) noexcept;
+
+	//! \brief Calls \p receiver with values of \p k, until \p receiver returns false
+	MODE_NOT_TAKE_RECEIVER(MODE) inline void Read(const K& k, F&& receiver) noexcept;
+
+	//! \brief
+	//! \param[in]
+	//! \return
+	MODE_TAKE_ONLY(MODE) inline V Take(const K& k) noexcept;
+
+	//! \brief
+	//! \param[in]
+	//! \param[in]
+	//! \return
+	MODE_TAKE_ONLY(MODE) inline bool Take(const K& k, V& v) noexcept;
+
+	//! \brief Takes values of \p k from all generations, until \p receiver returns false
+	MODE_TAKE_ONLY_RECEIVER(MODE) inline void Take(const K& k, F&& receiver) noexcept;
+
+	// There is no Find, since generations are freed once retired, use Read
+
+	//! \brief Takes the item of \p k, keeping the value in its node, see Hash::Extract
+	MODE_TAKE_ONLY(MODE) inline NodeHandle Extract(const K& k) noexcept;
+
+	//! \brief Takes an arbitrary item, newer generations first, see Hash::TakeAny
+	MODE_TAKE_ONLY(MODE) inline bool TakeAny(K& k, V& v) noexcept;
+
+	//! \brief Takes a value of \p k satisfying \p pred, newer generations first, see Hash::TakeIf
+	MODE_TAKE_ONLY_RECEIVER(MODE) inline bool TakeIf(const K& k, F&& pred, V& v) noexcept;
+
+public: // Iteration over all items of the live generations, see Hash::ForEach
+	//! \brief Calls \p visitor(const K&, const V&) for each item, MapMode::PARALLEL_INSERT_TAKE maps use DrainAll
+	//! \details Completes the copy of the previous generation first, so that no item is visited twice.
+	template <typename F>
+	inline void ForEach(F&& visitor) noexcept;
+
+	//! \brief ForEach on \p threads threads, see Hash::ParallelForEach
+	template <typename F>
+	inline void ParallelForEach(F&& visitor, const uint32_t threads) noexcept;
+
+	//! \brief Takes every item of all generations, see Hash::DrainAll
+	template <typename F>
+	inline size_t DrainAll(F&& visitor, const uint32_t threads = 1) noexcept;
+
+public: // Support functions
+	//! \brief Returns the number of items the live generations can hold together
+	inline uint64_t GetCapacity() const noexcept;
+
+	//! \brief Returns the number of generations, which are not retired
+	inline uint32_t GetLiveGenerations() const noexcept;
+
+private:
+	struct alignas(CACHE_LINE_SIZE) AdderSlot
+	{
+		std::atomic<uint32_t> count;
+	};
+
+	struct Generation
+	{
+		std::atomic<Table*> pTable;
+		// Adders currently adding to the table, spread over slots to keep Add free of shared writes
+		AdderSlot adders[GROWABLE_ADDER_SLOTS];
+		// Set once the generation is sealed and no adders remain, i.e. the table can only lose items
+		std::atomic<bool> isQuiescent;
+		// Take mode: buckets below the cursor are known to be empty, read modes: buckets below it are claimed for copy
+		std::atomic<uint32_t> retireCursor;
+		// Read modes: copy state of each bucket, allocated when the next generation is installed
+		std::atomic<std::atomic<uint8_t>*> pBuckets;
+		// Read modes: buckets, whose copy has ended
+		std::atomic<uint32_t> copied;
+		// Read modes: items added while the previous generation is copied, see AddToNewest
+		std::atomic<uint32_t> added;
+		// Take mode: nodes of the table held by a NodeHandle
+		std::atomic<uint32_t> handles;
+		// Links the retired generations waiting to be freed, see RetiredLinks
+		std::atomic<Generation*> pNextRetired;
+	};
+
+	//! \brief Chains retired generations through Generation::pNextRetired for the epoch domain
+	struct RetiredLinks
+	{
+		inline void Link(Generation* pGeneration, Generation* pNext) noexcept
+		{
+			pGeneration->pNextRetired.store(pNext, std::memory_order_relaxed);
+		}
+
+		inline Generation* Next(Generation* pGeneration) const noexcept
+		{
+			return pGeneration->pNextRetired.load(std::memory_order_relaxed);
+		}
+	};
+
+	typedef EpochDomain<Generation, true, RetiredLinks> Epochs;
+
+	//! \brief Frees the retired generations, which no operation can use anymore, when destroyed
+	struct Reclaimer
+	{
+		GrowableHash* pMap;
+
+		inline ~Reclaimer() noexcept
+		{
+			pMap->ReclaimRetired();
+		}
+	};
+
+	//! \brief Pins the map for an operation, the generations retired meanwhile are freed after the pin has ended
+	struct OperationGuard
+	{
+		inline explicit OperationGuard(GrowableHash& map) noexcept
+		    : reclaimer{&map}
+		    , pin(map.m_epochs)
+		{
+		}
+
+		Reclaimer reclaimer; // Destroyed after the pin
+		typename Epochs::Guard pin;
+	};
+
+	// Copy states of the buckets of a generation in read modes
+	constexpr static const uint8_t BUCKET_IN_PLACE = 0; // Items are read from this generation
+	constexpr static const uint8_t BUCKET_COPYING = 1;	// A thread is copying the items to the next generation
+	constexpr static const uint8_t BUCKET_COPIED = 2;	// Items are read from the next generation
+	constexpr static const uint8_t BUCKET_FAILED = 3;	// Items stay in this generation, the copy ran out of nodes
+
+	//! \brief Calls \p f for the table of each live generation, from newest to oldest
+	//! \return true as soon as \p f returns true
+	template <typename F>
+	inline bool ForEachGeneration(F&& f) noexcept;
+
+	//! \brief Calls \p add with the table of the newest generation, grows the map while \p add returns false
+	//! \details \p add may be called again with a newer table, so it must not consume its arguments on failure
+	template <typename F>
+	inline bool AddToNewest(const HashType hash, F&& add) noexcept;
+
+	//! \brief Installs generation \p current + 1 (unless another thread did it already) and makes it current
+	inline bool Grow(const uint32_t current) noexcept;
+
+	//! \brief Checks (take mode) or copies (read modes) a few buckets of the oldest generation, and retires the
+	//!		   generation once it's drained or copied
+	inline void HelpRetire() noexcept;
+
+	//! \brief Checks if the sealed \p generation has no adders left
+	inline bool IsQuiescent(Generation& generation) noexcept;
+
+	//! \brief Makes generation \p oldest + 1 the oldest live one, and retires \p oldest, unless done already
+	inline void RetireOldest(const uint32_t oldest) noexcept;
+
+	//! \brief Frees the retired generations, which no operation can use anymore
+	inline void ReclaimRetired() noexcept;
+
+	//! \brief Returns the callback of the epoch domain, which frees chains of expired generations
+	inline auto Recycler() noexcept;
+
+	inline HashedKey ComputeHash(const K& k) const noexcept;
+
+	//! \brief Returns the table holding the items of the key of \p hash, see read modes in the class description
+	inline Table* GetTableOf(const HashType hash) noexcept;
+
+	//! \brief Checks if the buckets of both candidates of \p hash in generation \p g are copied to the next generation
+	inline bool IsCopied(const uint32_t g, const HashType hash) const noexcept;
+
+	//! \brief Prepares an add of \p hash to generation \p current, while the generation preceding it is live
+	//! \details Copies the buckets of the candidates of \p hash. The capacity of the previous generation is reserved
+	//!			 for its copies, adds beyond it complete the copy first.
+	//! \return false if a bucket could not be copied
+	inline bool CopyBucketsOf(const uint32_t current, const HashType hash) noexcept;
+
+	//! \brief Copies bucket \p index of generation \p g to generation \p g + 1, unless another thread claimed it first
+	//! \param[in] wait	Waits for the other thread to finish the copy
+	//! \return Copy state of the bucket
+	inline uint8_t CopyBucket(const uint32_t g, const uint32_t index, const bool wait) noexcept;
+
+	//! \brief Adds copies of the items, which bucket \p index of \p from owns, to \p to
+	inline bool CopyItems(Table& from, Table& to, const uint32_t index) const noexcept;
+
+	//! \brief Returns the candidate bucket of \p hash, which placed the item found in bucket \p index
+	//! \details The item is in its candidate bucket or overflown from it. If both candidates may have placed it, the
+	//!			 nearer one owns it, so that each item is copied with exactly one bucket.
+	inline static uint32_t GetOwnerBucket(const Table& table, const HashType hash, const uint32_t index) noexcept;
+
+	//! \brief Copies the remaining buckets of the generations older than \p until, or until a bucket could not be
+	//!		   copied
+	//! \details Caller must not be an adder of a generation older than \p until, since it waits for them to quiesce.
+	//! \return The oldest live generation
+	inline uint32_t FinishCopy(const uint32_t until) noexcept;
+
+	//! \brief Calls \p f(table, filter) for the tables holding items, filter(k) tells whether \p f visits the item of k
+	//! \details Read modes only, see ForEach
+	template <typename F>
+	inline void ForEachCopiedTable(F&& f) noexcept;
+
+private:
+	Generation m_generations[GROWABLE_MAX_GENERATIONS];
+	std::atomic<uint32_t> m_current; // Newest generation, items are added only to it
+	std::atomic<uint32_t> m_oldest;	 // Oldest generation, which is not retired
+	std::atomic<uint32_t> m_retired; // Retired generations, which are not freed yet
+	const uint32_t m_initialElements;
+	const uint32_t m_seed;
+	const _Hasher m_hasher;
+
+	RetiredLinks m_links;
+	Epochs m_epochs;
+
+	DISABLE_COPY_MOVE(GrowableHash)
+};
+
+/// ******************************************************************************************* ///
+///                                                                                             ///
+///                                        Implementation                                       ///
+///                                                                                             ///
+/// ******************************************************************************************* ///
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GrowableHash(const uint32_t initial_elements,
+                                                                      const uint32_t seed /*= 0*/) noexcept
+    : m_current(0)
+    , m_oldest(0)
+    , m_retired(0)
+    , m_initialElements(initial_elements > 0 ? initial_elements : 1)
+    , m_seed(seed == 0 ? GenerateSeed() : seed)
+    , m_hasher(m_seed)
+    , m_epochs(m_links)
+{
+	for (uint32_t g = 0; g < GROWABLE_MAX_GENERATIONS; ++g)
+	{
+		Generation& generation = m_generations[g];
+		generation.pTable = nullptr;
+		for (uint32_t i = 0; i < GROWABLE_ADDER_SLOTS; ++i)
+		{
+			generation.adders[i].count = 0;
+		}
+		generation.isQuiescent = false;
+		generation.retireCursor = 0;
+		generation.pBuckets = nullptr;
+		generation.copied = 0;
+		generation.added = 0;
+		generation.handles = 0;
+		generation.pNextRetired = nullptr;
+	}
+	m_generations[0].pTable = new (std::nothrow) Table(m_initialElements, m_seed);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::~GrowableHash() noexcept
+{
+	// Generations freed already by the epoch domain are cleared
+	for (uint32_t g = 0; g < GROWABLE_MAX_GENERATIONS; ++g)
+	{
+		delete m_generations[g].pTable.load();
+		delete[] m_generations[g].pBuckets.load();
+	}
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Add(const K& k, const V& v) noexcept
+{
+	const OperationGuard guard(*this);
+	const HashedKey hk = ComputeHash(k);
+	return AddToNewest(hk.hash, [&](Table& table) { return table.AddHashed(hk, k, v); });
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Add(K&& k, V&& v) noexcept
+{
+	const OperationGuard guard(*this);
+	const HashedKey hk = ComputeHash(k);
+	// Hash::Add leaves k and v unchanged, if the item could not be added
+	return AddToNewest(hk.hash, [&](Table& table) { return table.Add(std::move(k), std::move(v)); });
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::AddToNewest(const HashType hash, F&& add) noexcept
+{
+	for (;;)
+	{
+		const uint32_t current = m_current.load(std::memory_order_acquire);
+		Generation& generation = m_generations[current];
+		Table* pTable = generation.pTable.load(std::memory_order_acquire);
+		if (pTable == nullptr)
+			return false;
+
+		// Adder registers before checking that the generation is still current, so a thread, which sees no adders
+		// after the generation was sealed, knows that no item can be added to it any more
+		std::atomic<uint32_t>& adders = generation.adders[GetThreadSlot() % GROWABLE_ADDER_SLOTS].count;
+		adders.fetch_add(1);
+		if (m_current.load() != current)
+		{
+			adders.fetch_sub(1, std::memory_order_release);
+			continue;
+		}
+
+		// Previous generation holds the items of the key, until its buckets are copied
+		bool copied = true;
+		if constexpr (!IS_INSERT_TAKE(OP_MODE))
+			copied = CopyBucketsOf(current, hash);
+		const bool added = copied && add(*pTable);
+		adders.fetch_sub(1, std::memory_order_release);
+		if (added)
+		{
+			if (current != m_oldest.load(std::memory_order_relaxed))
+				HelpRetire();
+			return true;
+		}
+
+		if (!copied || !Grow(current))
+			return false;
+	}
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL const V GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Read(const K& k) noexcept
+{
+	V v = V();
+	Read(k, v);
+	return v;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Read(const K& k, V& v) noexcept
+{
+	const OperationGuard guard(*this);
+	const HashedKey hk = ComputeHash(k);
+	Table* pTable = GetTableOf(hk.hash);
+	const bool found = pTable && pTable->ReadHashed(hk, k, v);
+	HelpRetire();
+	return found;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_RECEIVER_IMPL void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Read(
+    const K& k, F&& receiver) noexcept
+{
+	const OperationGuard guard(*this);
+	const HashedKey hk = ComputeHash(k);
+	if (Table* pTable = GetTableOf(hk.hash))
+		pTable->ReadHashed(hk, k, std::forward<F>(receiver));
+	HelpRetire();
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL typename GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::NodeHandle
+    GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Extract(const K& k) noexcept
+{
+	const OperationGuard guard(*this);
+	NodeHandle node;
+	const uint32_t oldest = m_oldest.load(std::memory_order_acquire);
+	for (uint32_t g = m_current.load(std::memory_order_acquire) + 1; g-- > oldest && !node;)
+	{
+		Generation& generation = m_generations[g];
+		if (Table* pTable = generation.pTable.load(std::memory_order_acquire))
+		{
+			// Handle is counted before the item is taken, so the generation isn't retired before it sees the handle
+			generation.handles.fetch_add(1);
+			typename Table::NodeHandle extracted = pTable->Extract(k);
+			if (extracted)
+				node = NodeHandle(std::move(extracted), &generation.handles);
+			else
+				generation.handles.fetch_sub(1, std::memory_order_release);
+		}
+	}
+	HelpRetire();
+	return node;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeAny(K& k, V& v) noexcept
+{
+	const OperationGuard guard(*this);
+	const bool found = ForEachGeneration([&](Table& table) { return table.TakeAny(k, v); });
+	HelpRetire();
+	return found;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_RECEIVER_IMPL bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeIf(const K& k,
+                                                                                                F&& pred,
+                                                                                                V& v) noexcept
+{
+	const OperationGuard guard(*this);
+	const bool found = ForEachGeneration([&](Table& table) { return table.TakeIf(k, pred, v); });
+	HelpRetire();
+	return found;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ForEach(F&& visitor) noexcept
+{
+	ParallelForEach(visitor, 1);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ParallelForEach(F&& visitor,
+                                                                             const uint32_t threads) noexcept
+{
+	static_assert(!IS_INSERT_TAKE(OP_MODE), "Items of MapMode::PARALLEL_INSERT_TAKE maps are visited by DrainAll");
+	const OperationGuard guard(*this);
+	ForEachCopiedTable([&](Table& table, const auto& filter) {
+		table.ParallelForEach(
+		    [&](const K& k, const V& v) {
+			    if (filter(k))
+				    visitor(k, v);
+		    },
+		    threads);
+	});
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+size_t GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::DrainAll(F&& visitor, const uint32_t threads) noexcept
+{
+	const OperationGuard guard(*this);
+	size_t drained = 0;
+	ForEachGeneration([&](Table& table) {
+		drained += table.DrainAll(visitor, threads);
+		return false;
+	});
+	HelpRetire();
+	return drained;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL V GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Take(const K& k) noexcept
+{
+	V v = V();
+	Take(k, v);
+	return v;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Take(const K& k, V& v) noexcept
+{
+	const OperationGuard guard(*this);
+	const uint32_t current = m_current.load(std::memory_order_acquire);
+	Table* pCurrent = m_generations[current].pTable.load(std::memory_order_acquire);
+	if (pCurrent && pCurrent->Take(k, v))
+	{
+		if (current != m_oldest.load(std::memory_order_relaxed))
+			HelpRetire();
+		return true;
+	}
+
+	// Item was either taken from a draining generation or not found at all, help to retire drained generations
+	const bool found = ForEachGeneration([&](Table& table) { return &table != pCurrent && table.Take(k, v); });
+	HelpRetire();
+	return found;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_RECEIVER_IMPL void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Take(
+    const K& k, F&& receiver) noexcept
+{
+	const OperationGuard guard(*this);
+	bool stop = false;
+	const auto forward = [&](const V& v) { return !(stop = !receiver(v)); };
+	ForEachGeneration([&](Table& table) {
+		table.Take(k, forward);
+		return stop;
+	});
+	HelpRetire();
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint64_t GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetCapacity() const noexcept
+{
+	// Capacities of the generations form a geometric series
+	const uint32_t current = m_current.load(std::memory_order_acquire);
+	const uint32_t oldest = m_oldest.load(std::memory_order_acquire);
+	return (uint64_t(m_initialElements) << (current + 1)) - (uint64_t(m_initialElements) << oldest);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint32_t GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetLiveGenerations() const noexcept
+{
+	return m_current.load(std::memory_order_acquire) - m_oldest.load(std::memory_order_acquire) + 1;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ForEachGeneration(F&& f) noexcept
+{
+	// Generations retired meanwhile are freed only after the operation has ended
+	const uint32_t oldest = m_oldest.load(std::memory_order_acquire);
+	for (uint32_t g = m_current.load(std::memory_order_acquire) + 1; g-- > oldest;)
+	{
+		if (Table* pTable = m_generations[g].pTable.load(std::memory_order_acquire))
+		{
+			if (f(*pTable))
+				return true;
+		}
+	}
+	return false;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Grow(const uint32_t current) noexcept
+{
+	const uint32_t next = current + 1;
+	if (next >= GROWABLE_MAX_GENERATIONS || (uint64_t(m_initialElements) << next) > GROWABLE_MAX_ELEMENTS)
+		return false;
+
+	if constexpr (!IS_INSERT_TAKE(OP_MODE))
+	{
+		// Items are copied to the next generation only, so the previous generation must be retired first
+		if (FinishCopy(current) < current)
+			return false;
+
+		Generation& generation = m_generations[current];
+		if (generation.pBuckets.load(std::memory_order_acquire) == nullptr)
+		{
+			// Value-initialized, i.e. BUCKET_IN_PLACE
+			std::atomic<uint8_t>* pNew = new (std::nothrow) std::atomic<uint8_t>[
+			    generation.pTable.load(std::memory_order_acquire)->GetKeyCount()]();
+			if (pNew == nullptr)
+				return false;
+			std::atomic<uint8_t>* pExpected = nullptr;
+			if (!generation.pBuckets.compare_exchange_strong(pExpected, pNew))
+				delete[] pNew;
+		}
+	}
+
+	Table* pTable = m_generations[next].pTable.load(std::memory_order_acquire);
+	if (pTable == nullptr)
+	{
+		Table* pNew = new (std::nothrow) Table(m_initialElements << next, m_seed);
+		if (pNew == nullptr)
+			return false;
+		if (!m_generations[next].pTable.compare_exchange_strong(pTable, pNew))
+			delete pNew; // Another thread installed the generation first
+	}
+
+	uint32_t expected = current;
+	m_current.compare_exchange_strong(expected, next);
+	return true;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::HelpRetire() noexcept
+{
+	const uint32_t oldest = m_oldest.load(std::memory_order_acquire);
+	if (oldest >= m_current.load())
+		return; // Only sealed generations are retired
+
+	Generation& generation = m_generations[oldest];
+	if (!IsQuiescent(generation))
+		return;
+
+	Table& table = *generation.pTable.load(std::memory_order_acquire);
+	const uint32_t keyCount = table.GetKeyCount();
+	if constexpr (IS_INSERT_TAKE(OP_MODE))
+	{
+		// Generation can only lose items now, so a bucket found empty stays empty
+		uint32_t cursor = generation.retireCursor.load(std::memory_order_acquire);
+		if (cursor < keyCount)
+		{
+			const uint32_t end = (keyCount - cursor > GROWABLE_RETIRE_STEP) ? cursor + GROWABLE_RETIRE_STEP : keyCount;
+			for (uint32_t i = cursor; i < end; ++i)
+			{
+				if (table.m_hash[i].GetUsage() != 0)
+					return;
+			}
+			if (!generation.retireCursor.compare_exchange_strong(cursor, end) || end < keyCount)
+				return;
+		}
+
+		// Extracted nodes are returned to the table, when their handles are destroyed
+		if (generation.handles.load() == 0)
+			RetireOldest(oldest);
+	}
+	else
+	{
+		if (generation.retireCursor.load(std::memory_order_relaxed) >= keyCount)
+			return;
+
+		// Buckets claimed by adders meanwhile are skipped, the generation is retired by the last copy
+		const uint32_t first = generation.retireCursor.fetch_add(GROWABLE_COPY_STEP);
+		for (uint32_t i = first; i < keyCount && i - first < GROWABLE_COPY_STEP; ++i)
+			CopyBucket(oldest, i, false);
+	}
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::IsQuiescent(Generation& generation) noexcept
+{
+	if (generation.isQuiescent.load(std::memory_order_acquire))
+		return true;
+
+	for (uint32_t i = 0; i < GROWABLE_ADDER_SLOTS; ++i)
+	{
+		if (generation.adders[i].count.load() != 0)
+			return false;
+	}
+	generation.isQuiescent.store(true, std::memory_order_release);
+	return true;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::RetireOldest(const uint32_t oldest) noexcept
+{
+	uint32_t expected = oldest;
+	if (m_oldest.compare_exchange_strong(expected, oldest + 1))
+	{
+		// Operations, which loaded the old m_oldest, may still use the generation
+		m_retired.fetch_add(1, std::memory_order_relaxed);
+		m_epochs.Retire(&m_generations[oldest], Recycler());
+	}
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ReclaimRetired() noexcept
+{
+	// A single attempt, operations keep trying while generations wait to be freed
+	if (m_retired.load(std::memory_order_relaxed) != 0)
+		m_epochs.Collect(Recycler(), 1);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+auto GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Recycler() noexcept
+{
+	return [this](Generation* pFirst, Generation* pLast) {
+		for (Generation* pGeneration = pFirst;; pGeneration = m_links.Next(pGeneration))
+		{
+			delete pGeneration->pTable.exchange(nullptr);
+			delete[] pGeneration->pBuckets.exchange(nullptr);
+			m_retired.fetch_sub(1, std::memory_order_relaxed);
+			if (pGeneration == pLast)
+				break;
+		}
+	};
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+typename GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::HashedKey
+    GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ComputeHash(const K& k) const noexcept
+{
+	// Generations share the seed, so the hash is valid in all of them
+	return HashedKey{m_hasher(k), m_seed};
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+typename GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Table*
+    GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetTableOf(const HashType hash) noexcept
+{
+	const uint32_t oldest = m_oldest.load(std::memory_order_acquire);
+	const uint32_t current = m_current.load(std::memory_order_acquire);
+	uint32_t g = oldest;
+	while (g < current && IsCopied(g, hash))
+		++g;
+	return m_generations[g].pTable.load(std::memory_order_acquire);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::IsCopied(const uint32_t g,
+                                                                       const HashType hash) const noexcept
+{
+	// Buckets are allocated before a generation is sealed, and freed only after it's retired
+	const Generation& generation = m_generations[g];
+	const Table& table = *generation.pTable.load(std::memory_order_acquire);
+	const std::atomic<uint8_t>* pBuckets = generation.pBuckets.load(std::memory_order_acquire);
+	for (uint32_t choice = 0; choice < 2; ++choice)
+	{
+		const uint32_t index = table.GetCandidateIndex(hash, choice);
+		if (index == ~0U)
+			break;
+		if (pBuckets[index].load(std::memory_order_acquire) != BUCKET_COPIED)
+			return false;
+	}
+	return true;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::CopyBucketsOf(const uint32_t current,
+                                                                            const HashType hash) noexcept
+{
+	if (current == 0 || current - 1 < m_oldest.load(std::memory_order_acquire))
+		return true;
+
+	// Items are added to the previous generation until its last adder leaves, which is a bounded wait
+	const uint32_t previous = current - 1;
+	if (m_generations[current].added.fetch_add(1, std::memory_order_relaxed) >= (m_initialElements << previous))
+		return FinishCopy(current) >= current;
+
+	while (!IsQuiescent(m_generations[previous]))
+		CpuRelax();
+
+	const Table& table = *m_generations[previous].pTable.load(std::memory_order_acquire);
+	for (uint32_t choice = 0; choice < 2; ++choice)
+	{
+		const uint32_t index = table.GetCandidateIndex(hash, choice);
+		if (index == ~0U)
+			break;
+		if (CopyBucket(previous, index, true) != BUCKET_COPIED)
+			return false;
+	}
+	return true;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint8_t GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::CopyBucket(const uint32_t g,
+                                                                           const uint32_t index,
+                                                                           const bool wait) noexcept
+{
+	Generation& generation = m_generations[g];
+	std::atomic<uint8_t>& bucket = generation.pBuckets.load(std::memory_order_acquire)[index];
+	uint8_t state = bucket.load(std::memory_order_acquire);
+	if (state == BUCKET_IN_PLACE && bucket.compare_exchange_strong(state, BUCKET_COPYING))
+	{
+		Table& table = *generation.pTable.load(std::memory_order_acquire);
+		Table& next = *m_generations[g + 1].pTable.load(std::memory_order_acquire);
+		state = CopyItems(table, next, index) ? BUCKET_COPIED : BUCKET_FAILED;
+		bucket.store(state, std::memory_order_release);
+
+		// Generation, whose copy failed, stays live
+		if (generation.copied.fetch_add(1) + 1 == table.GetKeyCount())
+		{
+			const std::atomic<uint8_t>* pBuckets = generation.pBuckets.load(std::memory_order_acquire);
+			bool complete = true;
+			for (uint32_t i = 0; i < table.GetKeyCount() && complete; ++i)
+				complete = pBuckets[i].load(std::memory_order_relaxed) == BUCKET_COPIED;
+			if (complete)
+				RetireOldest(g);
+		}
+		return state;
+	}
+
+	while (wait && state == BUCKET_COPYING)
+	{
+		CpuRelax();
+		state = bucket.load(std::memory_order_acquire);
+	}
+	return state;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::CopyItems(Table& from,
+                                                                        Table& to,
+                                                                        const uint32_t index) const noexcept
+{
+	// Generation is quiescent, so the overflow hint is final
+	bool copied = true;
+	const uint32_t overflow = from.m_hash[index].GetOverflow();
+	for (uint32_t distance = 0; distance <= overflow && copied; ++distance)
+	{
+		const uint32_t neighbour = from.GetNeighbourIndex(index, distance);
+		from.m_hash[neighbour].ForEachNode([&](typename Table::KeyValue& keyValue) {
+			if (!copied || GetOwnerBucket(from, keyValue.k.hash, neighbour) != index)
+				return;
+			keyValue.VisitValue([&](const V& v) {
+				copied = to.AddHashed(HashedKey{keyValue.k.hash, m_seed}, keyValue.k.key, v);
+				return true;
+			});
+		});
+	}
+	return copied;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint32_t GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetOwnerBucket(const Table& table,
+                                                                                const HashType hash,
+                                                                                const uint32_t index) noexcept
+{
+	uint32_t owner = ~0U;
+	uint32_t nearest = ~0U;
+	for (uint32_t choice = 0; choice < 2; ++choice)
+	{
+		const uint32_t candidate = table.GetCandidateIndex(hash, choice);
+		if (candidate == ~0U)
+			break;
+		const uint32_t distance = (index - candidate) & table.GetKeyMask();
+		if (distance <= table.m_hash[candidate].GetOverflow() && distance < nearest)
+		{
+			owner = candidate;
+			nearest = distance;
+		}
+	}
+	return owner;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint32_t GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::FinishCopy(const uint32_t until) noexcept
+{
+	for (;;)
+	{
+		const uint32_t oldest = m_oldest.load(std::memory_order_acquire);
+		if (oldest >= until)
+			return oldest;
+
+		while (!IsQuiescent(m_generations[oldest]))
+			CpuRelax();
+
+		const uint32_t keyCount = m_generations[oldest].pTable.load(std::memory_order_acquire)->GetKeyCount();
+		for (uint32_t i = 0; i < keyCount; ++i)
+			CopyBucket(oldest, i, true);
+
+		// The last copy retires the generation, unless a bucket could not be copied
+		if (m_oldest.load(std::memory_order_acquire) == oldest)
+			return oldest;
+	}
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+void GrowableHash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ForEachCopiedTable(F&& f) noexcept
+{
+	// Copy states of a generation, whose copy failed, don't change any more, so each item is visited exactly once
+	const uint32_t current = m_current.load(std::memory_order_acquire);
+	const uint32_t oldest = FinishCopy(current);
+	Table* pTable = m_generations[oldest].pTable.load(std::memory_order_acquire);
+	if (pTable == nullptr)
+		return;
+
+	if (oldest >= current)
+	{
+		// Map may have grown meanwhile, copies don't remove items from the generation
+		f(*pTable, [](const K&) { return true; });
+		return;
+	}
+
+	// Generation, whose copy failed, holds the items of its buckets, which could not be copied
+	f(*pTable, [&](const K& k) { return !IsCopied(oldest, m_hasher(k)); });
+	f(*m_generations[oldest + 1].pTable.load(std::memory_order_acquire),
+	  [&](const K& k) { return IsCopied(oldest, m_hasher(k)); });
+}
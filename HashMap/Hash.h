@@ -1,45 +1,148 @@
 ﻿#pragma once
 #include <assert.h>
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
 #include "Internal/HashFunctions.h"
+#include "Internal/Hashers.h"
 #include "Internal/HashUtils.h"
 #include "Internal/UtilityFunctions.h"
 #include "Internal/HashBase.h"
+#include "Internal/BucketSummary.h"
 
 #include "HashIterator.h"
 
 static_assert(__cplusplus >= 201103L, "C++11 or later required!");
 
-template <uint32_t MAX_ELEMENTS, uint32_t BUCKET_SIZE = DEFAULT_COLLISION_SIZE>
-struct StaticAllocator : public Allocator<AllocatorType::STATIC>,
+//! \brief Memory for the map is allocated statically
+//! \tparam MAGAZINE_SIZE	Size of per-thread node caches, zero (default) disables them
+template <uint32_t MAX_ELEMENTS, uint32_t BUCKET_SIZE = DEFAULT_COLLISION_SIZE, uint32_t MAGAZINE_SIZE = 0>
+struct StaticAllocator : public Allocator<AllocatorType::STATIC, MAGAZINE_SIZE>,
                          public StaticSizes<BUCKET_SIZE, MAX_ELEMENTS, ComputeHashKeyCount(MAX_ELEMENTS)>
 {
 	static_assert(MAX_ELEMENTS > 0, "Element count cannot be zero");
 };
 
-template <uint32_t BUCKET_SIZE = DEFAULT_COLLISION_SIZE>
-struct HeapAllocator : public Allocator<AllocatorType::HEAP>, public StaticSizes<BUCKET_SIZE>
+//! \brief Memory for the map is allocated from heap at construction
+//! \tparam MAGAZINE_SIZE	Size of per-thread node caches, zero (default) disables them
+template <uint32_t BUCKET_SIZE = DEFAULT_COLLISION_SIZE, uint32_t MAGAZINE_SIZE = 0>
+struct HeapAllocator : public Allocator<AllocatorType::HEAP, MAGAZINE_SIZE>, public StaticSizes<BUCKET_SIZE>
 {
 };
 
-template <uint32_t BUCKET_SIZE = DEFAULT_COLLISION_SIZE>
-struct ExternalAllocator : public Allocator<AllocatorType::EXTERNAL>, public StaticSizes<BUCKET_SIZE>
+//! \brief Memory for the map is provided by the user with Hash::Init
+//! \tparam MAGAZINE_SIZE	Size of per-thread node caches, zero (default) disables them
+template <uint32_t BUCKET_SIZE = DEFAULT_COLLISION_SIZE, uint32_t MAGAZINE_SIZE = 0>
+struct ExternalAllocator : public Allocator<AllocatorType::EXTERNAL, MAGAZINE_SIZE>, public StaticSizes<BUCKET_SIZE>
 {
 };
 
 template <typename K,
           typename V,
           typename _Alloc = HeapAllocator<>,
-          MapMode OP_MODE = DefaultModeSelector<K, _Alloc>::MODE>
-class Hash : private BaseResolver<K, V, _Alloc, OP_MODE>::Base
+          MapMode OP_MODE = DefaultModeSelector<K, _Alloc>::MODE,
+          BucketPlacement PLACEMENT = BucketPlacement::SINGLE,
+          typename _Hasher = DefaultHasher<K>>
+class Hash : private BaseResolver<K, V, _Alloc, OP_MODE, HashTypeOf<K, _Hasher>>::Base
 {
-	typedef typename BaseResolver<K, V, _Alloc, OP_MODE>::Base Base;
+	typedef typename BaseResolver<K, V, _Alloc, OP_MODE, HashTypeOf<K, _Hasher>>::Base Base;
 	typedef typename std::integral_constant<MapMode, OP_MODE> MODE;
 	typedef typename Base::AT AT;
 
+	static_assert(PLACEMENT == BucketPlacement::SINGLE || !IS_INSERT_READ_FROM_HEAP(OP_MODE),
+	              "BucketPlacement::TWO_CHOICE is not supported in PARALLEL_INSERT_READ_GROW_FROM_HEAP mode");
+
 public:
 	typedef typename Base::KeyValue KeyValue;
 	typedef typename Base::Bucket Bucket;
+	//! \brief Width of the hashes, selected by the return type of _Hasher
+	typedef HashTypeOf<K, _Hasher> HashType;
+	typedef HashedKeyT<HashType> HashedKey;
+
+	static_assert(std::is_same<HashType, uint32_t>::value || std::is_same<HashType, uint64_t>::value,
+	              "Hasher must return uint32_t or uint64_t");
+
+	//! \brief Owns the node of an item taken with Extract, the node is returned to the map on destruction
+	//! \details Value is accessed in place, without copying it out of the node. Handle must not outlive the map.
+	class NodeHandle
+	{
+	public:
+		inline NodeHandle() noexcept
+		    : m_pHash(nullptr)
+		    , m_pKeyValue(nullptr)
+		{
+		}
+
+		inline NodeHandle(NodeHandle&& other) noexcept
+		    : m_pHash(other.m_pHash)
+		    , m_pKeyValue(other.m_pKeyValue)
+		{
+			other.m_pKeyValue = nullptr;
+		}
+
+		inline NodeHandle& operator=(NodeHandle&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Reset();
+				m_pHash = other.m_pHash;
+				m_pKeyValue = other.m_pKeyValue;
+				other.m_pKeyValue = nullptr;
+			}
+			return *this;
+		}
+
+		inline ~NodeHandle() noexcept
+		{
+			Reset();
+		}
+
+		//! \brief Returns true if the handle owns a node, i.e. the item was found
+		inline explicit operator bool() const noexcept
+		{
+			return m_pKeyValue != nullptr;
+		}
+
+		inline V& operator*() const noexcept
+		{
+			return m_pKeyValue->v;
+		}
+
+		inline V* operator->() const noexcept
+		{
+			return &m_pKeyValue->v;
+		}
+
+		//! \brief Returns the node to the map, the handle becomes empty
+		inline void Reset() noexcept
+		{
+			if (m_pKeyValue)
+			{
+				m_pHash->ReleaseNode(m_pKeyValue);
+				m_pKeyValue = nullptr;
+			}
+		}
+
+	private:
+		inline NodeHandle(Hash* pHash, KeyValue* pKeyValue) noexcept
+		    : m_pHash(pHash)
+		    , m_pKeyValue(pKeyValue)
+		{
+		}
+
+		Hash* m_pHash;
+		KeyValue* m_pKeyValue;
+
+		friend class Hash;
+
+		NodeHandle(const NodeHandle&) = delete;
+		NodeHandle& operator=(const NodeHandle&) = delete;
+	};
 
 public: // Construction and initialization
 	//! \brief
@@ -62,12 +165,15 @@ public: // Construction and initialization
 	//! \param[in]
 	//! \param[in]
 	//! \param[in]
+	//! \param[in] summary	ComputeSummaryWordCount(ComputeHashKeyCount(max_elements)) words for the bitmap, which
+	//!						TakeAny uses to skip empty buckets, without it TakeAny scans the buckets
 	//! \return
 	EXT_ONLY(AT)
 	inline bool Init(const uint32_t max_elements,
 	                 Bucket* hash,
 	                 KeyValue* keyStorage,
-	                 std::atomic<KeyValue*>* keyRecycle) noexcept;
+	                 std::atomic<KeyValue*>* keyRecycle,
+	                 std::atomic<uint64_t>* summary = nullptr) noexcept;
 
 public: // Access functions
 	//! \brief
@@ -76,6 +182,19 @@ public: // Access functions
 	//! \return
 	inline bool Add(const K& k, const V& v) noexcept;
 
+	//! \brief Add, which moves \p k and \p v into the node instead of copying them
+	//! \details \p k and \p v are left unchanged, if the item cannot be added
+	inline bool Add(K&& k, V&& v) noexcept;
+
+	//! \brief Adds \p k with a value constructed in the node from \p args
+	//! \details Arguments passed as rvalues may have been moved from, even if the item cannot be added
+	template <typename... Args>
+	inline bool Emplace(const K& k, Args&&... args) noexcept;
+
+	//! \brief Emplace, which moves \p k into the node
+	template <typename... Args>
+	inline bool Emplace(K&& k, Args&&... args) noexcept;
+
 	//! \brief
 	//! \param[in]
 	//! \return
@@ -87,16 +206,14 @@ public: // Access functions
 	//! \return
 	MODE_NOT_TAKE(MODE) inline const bool Read(const K& k, V& v) noexcept;
 
-	//! \brief
-	//! \param[in]
-	//! \param[in]
-	//! \return
-	MODE_NOT_TAKE(MODE) inline void Read(const K& k, const std::function<bool(const V&)>& receiver) noexcept;
+	//! \brief Calls \p receiver with the values of \p k, until \p receiver returns false
+	//! \details \p receiver is any callable with signature bool(const V&), it is inlined into the bucket scan
+	MODE_NOT_TAKE_RECEIVER(MODE) inline void Read(const K& k, F&& receiver) noexcept;
 
 	//! \brief
 	//! \param[in]
 	//! \return
-	MODE_TAKE_ONLY(MODE) inline const V Take(const K& k) noexcept;
+	MODE_TAKE_ONLY(MODE) inline V Take(const K& k) noexcept;
 
 	//! \brief
 	//! \param[in]
@@ -104,11 +221,166 @@ public: // Access functions
 	//! \return
 	MODE_TAKE_ONLY(MODE) inline bool Take(const K& k, V& v) noexcept;
 
-	//! \brief
-	//! \param[in]
-	//! \param[in]
-	//! \return
-	MODE_TAKE_ONLY(MODE) inline void Take(const K& k, const std::function<bool(const V&)>& receiver) noexcept;
+	//! \brief Takes the values of \p k, passing each to \p receiver until \p receiver returns false
+	//! \details \p receiver is any callable with signature bool(const V&), it is inlined into the bucket scan
+	MODE_TAKE_ONLY_RECEIVER(MODE) inline void Take(const K& k, F&& receiver) noexcept;
+
+	//! \brief Returns the value of \p k in place, without copying it
+	//! \details Not available in MapMode::PARALLEL_INSERT_READ_ERASE, which recycles the nodes of erased items, nor
+	//!			 in PARALLEL_INSERT_READ_UPDATE for values updated under a seqlock (see Upsert), which cannot be read in
+	//!			 place without tearing. Arithmetic and pointer values of PARALLEL_INSERT_READ_UPDATE maps, which may be
+	//!			 updated concurrently, must be loaded with AtomicRef.
+	//! \return Pointer to the value, which stays valid for the lifetime of the map, or nullptr if \p k is not found
+	MODE_NOT_TAKE(MODE) inline const V* Find(const K& k) noexcept;
+
+	//! \brief Takes the item of \p k, but keeps the value in its node until the returned handle is destroyed
+	//! \return Handle owning the node, or an empty handle if \p k is not found
+	MODE_TAKE_ONLY(MODE) inline NodeHandle Extract(const K& k) noexcept;
+
+	//! \brief Takes an arbitrary item, e.g. to distribute work among consumers, which don't care about the key
+	//! \details Search starts from a bucket rotating per call and thread, so consumers spread over the map, and
+	//!			 skips empty buckets with a hierarchical bitmap of the non-empty ones (see BucketSummary).
+	//! \param[out] k	Key of the item taken
+	//! \param[out] v	Value of the item taken
+	//! \return false if no item was found
+	MODE_TAKE_ONLY(MODE) inline bool TakeAny(K& k, V& v) noexcept;
+
+	//! \brief Takes a value of \p k, which satisfies \p pred, leaving the other values of \p k in place
+	//! \details \p pred is any callable with signature bool(const V&). It sees a copy of each trivially copyable value
+	//!			 before its item is taken. Other values are seen in place, while the item is reserved, so \p pred must
+	//!			 be short and must not take from the map: other takes of the item wait meanwhile.
+	//! \param[out] v	Value taken
+	//! \return false if no value of \p k satisfied \p pred
+	MODE_TAKE_ONLY_RECEIVER(MODE) inline bool TakeIf(const K& k, F&& pred, V& v) noexcept;
+
+	//! \brief Takes the value of \p k, blocking until another thread adds \p k, if it is not found
+	//! \details The thread parks on a sequence word of the first candidate bucket of \p k, which adds of keys with
+	//!			 this candidate bump only while waiters are flagged, so adds without waiters pay a single load.
+	//!			 Any add to the bucket wakes the thread, which then retries.
+	//! \param[in] timeout	Longest time to block, the default blocks until \p k is added
+	//! \return false if \p k was not added before \p timeout expired
+	MODE_TAKE_ONLY(MODE)
+	inline bool TakeWait(const K& k, V& v, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max()) noexcept;
+
+	//! \brief Adds the records of [\p first, \p last) using \p threads threads, e.g. to populate a map at startup
+	//! \details Records are hashed and radix-partitioned by bucket index in parallel, then threads fill the map one
+	//!			 partition at a time, so writes to the buckets stay within a cache-sized range. Map can be used
+	//!			 concurrently, but the partitioning only pays off for a map, which is not yet in use.
+	//! \param[in] threads	Number of threads including the caller, zero uses all hardware threads
+	//! \return Number of records added, i.e. less than the number of records if the map got full
+	//! \constrains RandomIt is a random access iterator to records with members first (K) and second (V),
+	//!			 e.g. std::pair<K, V>
+	template <typename RandomIt>
+	inline size_t BulkLoad(RandomIt first, RandomIt last, uint32_t threads = 0) noexcept;
+
+public: // Batched access functions
+	// Keys are processed in groups of LOOKUP_BATCH_SIZE: the whole group is hashed and its buckets and candidate
+	// nodes are prefetched before the first lookup, so the cache misses of the group overlap.
+
+	//! \brief Reads the values of \p n keys
+	//! \param[out] out		Values of the found keys, values of missing keys are left unchanged
+	//! \param[out] found	Whether each key was found, can be nullptr
+	//! \return Number of keys found
+	MODE_NOT_TAKE(MODE)
+	inline size_t ReadMany(const K* keys, const size_t n, V* out, bool* found = nullptr) noexcept;
+
+	//! \brief Takes the values of \p n keys
+	//! \param[out] out		Values of the found keys, values of missing keys are left unchanged
+	//! \param[out] found	Whether each key was found, can be nullptr
+	//! \return Number of keys found
+	MODE_TAKE_ONLY(MODE)
+	inline size_t TakeMany(const K* keys, const size_t n, V* out, bool* found = nullptr) noexcept;
+
+public: // Access functions with a precomputed hash
+	// A hash computed with another seed than the seed of the map is ignored and computed again from the key.
+	// Debug builds assert, that a hash with the seed of the map matches its key.
+
+	//! \brief Computes the hash of \p k with the hasher and the seed of this map
+	inline HashedKey ComputeHash(const K& k) const noexcept;
+
+	//! \brief Add with a precomputed hash \p hk of \p k
+	inline bool AddHashed(const HashedKey& hk, const K& k, const V& v) noexcept;
+
+	//! \brief Read with a precomputed hash \p hk of \p k
+	MODE_NOT_TAKE(MODE) inline const V ReadHashed(const HashedKey& hk, const K& k) noexcept;
+
+	//! \brief Read with a precomputed hash \p hk of \p k
+	MODE_NOT_TAKE(MODE) inline const bool ReadHashed(const HashedKey& hk, const K& k, V& v) noexcept;
+
+	//! \brief Read with a precomputed hash \p hk of \p k
+	MODE_NOT_TAKE_RECEIVER(MODE) inline void ReadHashed(const HashedKey& hk, const K& k, F&& receiver) noexcept;
+
+	//! \brief Take with a precomputed hash \p hk of \p k
+	MODE_TAKE_ONLY(MODE) inline V TakeHashed(const HashedKey& hk, const K& k) noexcept;
+
+	//! \brief Take with a precomputed hash \p hk of \p k
+	MODE_TAKE_ONLY(MODE) inline bool TakeHashed(const HashedKey& hk, const K& k, V& v) noexcept;
+
+	//! \brief Take with a precomputed hash \p hk of \p k
+	MODE_TAKE_ONLY_RECEIVER(MODE) inline void TakeHashed(const HashedKey& hk, const K& k, F&& receiver) noexcept;
+
+public: // In-place updates of MapMode::PARALLEL_INSERT_READ_UPDATE maps
+	// A key is added only if it is absent, such adds are serialized by striped locks. Values of existing keys are
+	// updated lock-free: arithmetic values and pointers with atomic operations, other trivially copyable values
+	// under the seqlock of their node, so readers never see a torn value (see KeyValueInsertRead::LoadValue).
+	// Items added with Add are not checked for duplicates.
+	//
+	// These functions are not lock-free for absent keys: the adding thread holds the lock of the stripe of the key
+	// (UPSERT_LOCK_STRIPES stripes), and adds of other absent keys of the stripe block until it's released.
+	// Without removal, a duplicate of an optimistic add could not be taken back, so adds are not optimistic.
+
+	//! \brief Sets the value of \p k to \p v, adds \p k if it is absent
+	//! \return false if \p k was absent and could not be added
+	MODE_UPDATE_ONLY(MODE) inline bool Upsert(const K& k, const V& v) noexcept;
+
+	//! \brief Calls \p f(V&) to modify the value of \p k in place, adds \p k with V() modified by \p f if it is absent
+	//! \details \p f may be called more than once for atomic values, see KeyValueInsertRead::UpdateValue
+	//! \return false if \p k was absent and could not be added
+	template <typename F>
+	inline bool Update(const K& k, F&& f) noexcept;
+
+	//! \brief Adds \p delta to the arithmetic value of \p k, adds \p k with value \p delta if it is absent
+	//! \param[out] pPrevious	Value before the addition, V() if \p k was absent
+	//! \return false if \p k was absent and could not be added
+	MODE_UPDATE_ONLY(MODE) inline bool FetchAdd(const K& k, const V& delta, V* pPrevious = nullptr) noexcept;
+
+public: // Removal of MapMode::PARALLEL_INSERT_READ_ERASE maps
+	// Erased items are replaced by tombstones. Their nodes are retired to the epoch of the map, which readers pin, and
+	// return to the pool once every operation, which may still use them, has ended. Once its bucket is full, Add
+	// reuses the slot of a tombstone.
+
+	//! \brief Erases all items of \p k, the map can be used concurrently
+	//! \return Number of items erased
+	MODE_ERASE_ONLY(MODE) inline uint32_t Erase(const K& k) noexcept;
+
+	//! \brief Returns the nodes of erased items, which no running operation can use anymore, to the pool
+	//! \details Add does the same once the pool runs dry, and erasing threads every EPOCH_BATCH nodes, so calling
+	//!			 Reclaim is optional. Can be called concurrently with any operation, the nodes of operations
+	//!			 running meanwhile are returned by a later call.
+	//! \return Number of nodes returned
+	MODE_ERASE_ONLY(MODE) inline uint32_t Reclaim() noexcept;
+
+public: // Iteration over all items
+	// Buckets are visited in order of their index. The parallel variants split them in to chunks of
+	// FOR_EACH_CHUNK_BUCKETS buckets, which the threads claim one at a time, so fast threads take over the chunks of
+	// slow ones. Iteration is weakly consistent with concurrent modifications: an item, which is in the map during the
+	// whole iteration, is visited exactly once; an item added or removed meanwhile may or may not be visited. Values
+	// are read like in Read, i.e. an updated value is seen before or after its update.
+
+	//! \brief Calls \p visitor(const K&, const V&) for each item, MapMode::PARALLEL_INSERT_TAKE maps use DrainAll
+	template <typename F>
+	inline void ForEach(F&& visitor) noexcept;
+
+	//! \brief ForEach on \p threads threads, i.e. \p visitor is called concurrently
+	template <typename F>
+	inline void ParallelForEach(F&& visitor, const uint32_t threads) noexcept;
+
+	//! \brief Takes every item of a MapMode::PARALLEL_INSERT_TAKE map, and passes it to \p visitor(const K&, V&)
+	//! \details Each item is taken atomically like in Take, so it's either drained or taken by another thread.
+	//!			 \p visitor may move the value out, it's called concurrently if \p threads is more than one.
+	//! \return Number of items drained
+	template <typename F>
+	inline size_t DrainAll(F&& visitor, const uint32_t threads = 1) noexcept;
 
 public: // Support functions
 	//! \brief
@@ -122,18 +394,132 @@ public: // Support functions
 	constexpr static MapMode GetMapMode() noexcept;
 
 private:
-	uint32_t GetKeyHash(const K& k) const noexcept;
-	uint32_t GetKeyIndex(const uint32_t hash) const noexcept;
+	//! \brief Probe sequence of a hash, i.e. each candidate bucket followed by the buckets holding its overflown items
+	//! \details Buckets are returned one at a time, so that a caller can prefetch a bucket and suspend before visiting
+	//!			 it (see InterleavedLookup). The overflow hint of a candidate is read only after the candidate was
+	//!			 visited, so that a bucket, which never overflowed, costs a single load on a miss.
+	class BucketProbe
+	{
+	public:
+		inline BucketProbe(Hash& hash, const HashType h) noexcept
+		    : m_pHash(&hash)
+		    , m_h(h)
+		    , m_choice(0)
+		    , m_index(~0U)
+		    , m_distance(0)
+		    , m_overflow(0)
+		{
+		}
+
+		//! \brief Returns the next bucket of the sequence, or nullptr once all buckets were returned
+		inline Bucket* Next() noexcept
+		{
+			if (m_index != ~0U)
+			{
+				if (m_distance == 0)
+					m_overflow = m_pHash->m_hash[m_index].GetOverflow();
+				if (m_distance < m_overflow)
+					return &m_pHash->m_hash[m_pHash->GetNeighbourIndex(m_index, ++m_distance)];
+			}
+
+			if (m_choice > 1)
+				return nullptr;
+			m_index = m_pHash->GetCandidateIndex(m_h, m_choice++);
+			m_distance = 0;
+			return (m_index != ~0U) ? &m_pHash->m_hash[m_index] : nullptr;
+		}
+
+		//! \brief Called in take and erase modes, after an item was taken from the bucket returned last
+		//! \details Lowers the overflow hint of the candidate, if the item may have been its farthest overflown item.
+		inline void Taken() noexcept
+		{
+			if (m_distance > 0 && m_distance == m_overflow)
+				m_pHash->ShrinkOverflow(m_index);
+		}
+
+	private:
+		Hash* m_pHash;
+		HashType m_h;
+		uint32_t m_choice;	 // Candidate to be visited after the current one
+		uint32_t m_index;	 // Index of the current candidate bucket
+		uint32_t m_distance; // Distance of the bucket returned last from the current candidate
+		uint32_t m_overflow; // Overflow hint of the current candidate, read after visiting it
+	};
+
+	HashType GetKeyHash(const K& k) const noexcept;
+	//! \brief Returns the hash of \p hk, or computes it from \p k if \p hk was computed with another seed
+	inline HashType ResolveHash(const HashedKey& hk, const K& k) const noexcept;
+	//! \brief Selects the bucket by the low bits of \p hash, fingerprints use the high bits
+	uint32_t GetKeyIndex(const HashType hash) const noexcept;
+	uint32_t GetNeighbourIndex(const uint32_t index, const uint32_t distance) const noexcept;
+
+	//! \brief Returns the index of candidate bucket \p choice (0 or 1) of \p hash
+	//! \return Index of the bucket, or ~0U if the candidate does not exist
+	inline uint32_t GetCandidateIndex(const HashType hash, const uint32_t choice) const noexcept;
+
+	//! \brief Returns the index of the bucket a new item with \p hash is added to
+	inline uint32_t GetPlacementIndex(const HashType hash) const noexcept;
+
+	//! \brief Calls \p f for each bucket in the probe sequence of \p hash, see BucketProbe
+	//! \return true as soon as \p f returns true, false if \p f returned false for all buckets
+	template <typename F>
+	inline bool ForEachCandidateBucket(const HashType hash, F&& f) noexcept;
+
+	//! \brief Adds an item with key \p k and a value constructed from \p args
+	//! \param[in] rollback	Called with the node, if no bucket has room for it, before the node is released
+	template <typename _K, typename R, typename... Args>
+	inline bool AddNode(const HashedKey& hk, _K&& k, R&& rollback, Args&&... args) noexcept;
+
+	//! \brief Adds the records of [\p first, \p last) one at a time
+	template <typename RandomIt>
+	inline size_t AddSequentially(RandomIt first, RandomIt last) noexcept;
+
+	//! \brief Calls \p lookup(i, hash) for each of the \p n keys, see ReadMany
+	//! \return Number of keys, for which \p lookup returned true
+	template <typename F>
+	inline size_t ForEachKeyPrefetched(const K* keys, const size_t n, bool* found, F&& lookup) noexcept;
+
+	//! \brief Calls \p f(first, last) for chunks of FOR_EACH_CHUNK_BUCKETS buckets, covering all buckets once
+	template <typename F>
+	inline void ForEachBucketChunk(const uint32_t threads, F&& f) noexcept;
+
+	//! \brief Returns the node of \p k, whose hash is \p h, or nullptr if \p k is not found
+	MODE_NOT_TAKE(MODE) inline KeyValue* FindNode(const HashType h, const K& k) noexcept;
+
+	//! \brief Calls \p update with the node of \p k, or adds \p k with value \p make() if \p k is absent
+	template <typename U, typename M>
+	inline bool UpdateOrAdd(const K& k, U&& update, M&& make) noexcept;
+
+	//! \brief Adds an item, whose own bucket in \p index is full, to the first following bucket with room
+	//! \details Buckets up to OVERFLOW_MAX_DISTANCE after \p index are tried.
+	inline bool AddToOverflow(const uint32_t index, KeyValue* pKeyValue) noexcept;
+
+	//! \brief Lowers the overflow hint of the bucket in \p index to the farthest bucket, which may still hold its items
+	inline void ShrinkOverflow(const uint32_t index) noexcept;
+
+	//! \brief Calls ShrinkOverflow for the candidate buckets of \p hash, whose farthest overflown item may have been
+	//!			taken from the bucket in \p index
+	inline void ShrinkOverflowOf(const HashType hash, const uint32_t index) noexcept;
 
 private:
 	Container<Bucket, _Alloc::ALLOCATOR, _Alloc::KEY_COUNT> m_hash;
+	// Buckets, which may hold items, for TakeAny
+	BucketSummary<IS_INSERT_TAKE(OP_MODE), _Alloc::ALLOCATOR, _Alloc::KEY_COUNT> m_summary;
 
 	const uint32_t m_seed;
+	const _Hasher m_hasher;
+
+	// Serializes adds of absent keys by UpdateOrAdd, only MapMode::PARALLEL_INSERT_READ_UPDATE maps update values
+	UpsertLocks<IS_INSERT_READ_UPDATE(OP_MODE)> m_upsertLocks;
 
-	friend class HashIterator<Hash<K, V, _Alloc, OP_MODE>>;
+	friend class HashIterator<Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>>;
+	template <typename _K, typename _V, typename _A, MapMode _M, BucketPlacement _P, typename _H>
+	friend class GrowableHash;
+	template <typename _H, uint32_t _N>
+	friend class InterleavedLookup;
 
 	// Validate
-	constexpr static const KeyPropertyValidator<K, OP_MODE> VALIDATOR{};
+	constexpr static const KeyPropertyValidator<K, OP_MODE, HashType> VALIDATOR{};
 
 	typedef typename Base::KeyHashPair KeyHashPair;
 	typedef typename K KeyType;
@@ -148,156 +534,635 @@ private:
 ///                                                                                             ///
 /// ******************************************************************************************* ///
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-STATIC_ONLY_IMPL Hash<K, V, _Alloc, OP_MODE>::Hash(const uint32_t seed /*= 0*/) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+STATIC_ONLY_IMPL Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Hash(const uint32_t seed /*= 0*/) noexcept
     : Base()
     , m_hash()
+    , m_summary()
     , m_seed(seed == 0 ? GenerateSeed() : seed)
+    , m_hasher(m_seed)
 {
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-HEAP_ONLY_IMPL Hash<K, V, _Alloc, OP_MODE>::Hash(const uint32_t max_elements, const uint32_t seed /*= 0*/) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+HEAP_ONLY_IMPL Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Hash(const uint32_t max_elements,
+                                                                     const uint32_t seed /*= 0*/) noexcept
     : Base(max_elements)
     , m_hash(ComputeHashKeyCount(max_elements))
+    , m_summary(ComputeHashKeyCount(max_elements))
     , m_seed(seed == 0 ? GenerateSeed() : seed)
+    , m_hasher(m_seed)
 {
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-EXT_ONLY_IMPL Hash<K, V, _Alloc, OP_MODE>::Hash() noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+EXT_ONLY_IMPL Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Hash() noexcept
     : m_seed(GenerateSeed())
+    , m_hasher(m_seed)
 {
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-EXT_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE>::Init(const uint32_t max_elements,
-                                                     Bucket* hash,
-                                                     KeyValue* keyStorage,
-                                                     std::atomic<KeyValue*>* keyRecycle) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+EXT_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Init(const uint32_t max_elements,
+                                                                         Bucket* hash,
+                                                                         KeyValue* keyStorage,
+                                                                         std::atomic<KeyValue*>* keyRecycle,
+                                                                         std::atomic<uint64_t>* summary) noexcept
 {
 	if (Base::Init(max_elements))
 	{
 		m_hash.Init(hash, ComputeHashKeyCount(max_elements));
 		Base::m_keyStorage.Init(keyStorage, max_elements);
 		Base::m_recycle.Init(keyRecycle, max_elements);
+		Base::InitFreeList();
+		m_summary.Init(summary, Base::GetKeyCount());
+		return true;
+	}
+	return false;
+}
 
-		for (uint32_t i = 0; i < Base::GetMaxElements(); ++i)
-		{
-			Base::m_recycle[i] = &Base::m_keyStorage[i];
-		}
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Add(const K& k, const V& v) noexcept
+{
+	return AddHashed(ComputeHash(k), k, v);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Add(K&& k, V&& v) noexcept
+{
+	const HashedKey hk = ComputeHash(k);
+	return AddNode(
+	    hk,
+	    std::move(k),
+	    [&](KeyValue* pKeyValue) {
+		    // Keys of take mode are trivially copyable, so they were copied rather than moved
+		    if constexpr (!IS_INSERT_TAKE(OP_MODE))
+			    k = std::move(pKeyValue->k.key);
+		    v = std::move(pKeyValue->v);
+	    },
+	    std::move(v));
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename... Args>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Emplace(const K& k, Args&&... args) noexcept
+{
+	return AddNode(ComputeHash(k), k, [](KeyValue*) {}, std::forward<Args>(args)...);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename... Args>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Emplace(K&& k, Args&&... args) noexcept
+{
+	const HashedKey hk = ComputeHash(k);
+	return AddNode(hk, std::move(k), [](KeyValue*) {}, std::forward<Args>(args)...);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL const V Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Read(const K& k) noexcept
+{
+	return ReadHashed(ComputeHash(k), k);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL const bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Read(const K& k, V& v) noexcept
+{
+	return ReadHashed(ComputeHash(k), k, v);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_RECEIVER_IMPL void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Read(const K& k,
+                                                                                     F&& receiver) noexcept
+{
+	ReadHashed(ComputeHash(k), k, std::forward<F>(receiver));
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL const V* Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Find(const K& k) noexcept
+{
+	static_assert(!IS_INSERT_READ_ERASE(OP_MODE),
+	              "Find is not available in MapMode::PARALLEL_INSERT_READ_ERASE, the value of an erased item would be "
+	              "recycled under the pointer, use Read");
+	static_assert(!(IS_INSERT_READ_UPDATE(OP_MODE) && IsSeqLockedValue<V>),
+	              "Find would read values, which Upsert and Update write under a seqlock, without the seqlock, use "
+	              "Read or MapMode::PARALLEL_INSERT_READ");
+	if (KeyValue* pKeyValue = FindNode(GetKeyHash(k), k))
+		return &pKeyValue->v;
+	return nullptr;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL typename Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::NodeHandle
+    Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Extract(const K& k) noexcept
+{
+	const auto pin = Base::Pin();
+	const auto h = GetKeyHash(k);
+	KeyValue* pKeyValue = nullptr;
+	if (ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.TakeValue(k, h, &pKeyValue); }))
+		return NodeHandle(this, pKeyValue);
+	return NodeHandle();
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeAny(K& k, V& v) noexcept
+{
+	// Golden ratio stride spreads the start buckets of consecutive calls and of different threads
+	thread_local uint32_t rotation = GetThreadSlot() * 0x9E3779B9U;
+	rotation += 0x9E3779B9U;
+
+	const auto pin = Base::Pin();
+	KeyValue* pKeyValue = nullptr;
+	HashType h = 0;
+	uint32_t taken = 0;
+	const bool found = m_summary.FindAny(
+	    rotation % Base::GetKeyCount(),
+	    [&](const uint32_t index) {
+		    if (!m_hash[index].TakeAny(k, h, &pKeyValue))
+			    return false;
+		    taken = index;
+		    return true;
+	    },
+	    [&](const uint32_t index) { return m_hash[index].GetUsage() == 0; });
+	if (found)
+	{
+		v = std::move(pKeyValue->v);
+		Base::ReleaseNode(pKeyValue);
+		ShrinkOverflowOf(h, taken);
+	}
+	return found;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_RECEIVER_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeIf(const K& k,
+                                                                                        F&& pred,
+                                                                                        V& v) noexcept
+{
+	const auto pin = Base::Pin();
+	const auto h = GetKeyHash(k);
+	KeyValue* pKeyValue = nullptr;
+	if (ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.TakeValueIf(k, h, pred, &pKeyValue); }))
+	{
+		v = std::move(pKeyValue->v);
+		Base::ReleaseNode(pKeyValue);
 		return true;
 	}
 	return false;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-bool Hash<K, V, _Alloc, OP_MODE>::Add(const K& k, const V& v) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeWait(
+    const K& k, V& v, const std::chrono::nanoseconds timeout) noexcept
 {
-	KeyValue* pKeyValue = Base::GetNextFreeKeyValue();
-	if (pKeyValue == nullptr)
+	const HashedKey hk = ComputeHash(k);
+	if (TakeHashed(hk, k, v))
+		return true;
+
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point now = Clock::now();
+	const Clock::time_point deadline = timeout >= Clock::time_point::max() - now
+	                                       ? Clock::time_point::max()
+	                                       : now + std::chrono::duration_cast<Clock::duration>(timeout);
+
+	Bucket& bucket = m_hash[GetCandidateIndex(hk.hash, 0)];
+	for (;;)
+	{
+		const uint32_t sequence = bucket.AnnounceWaiter();
+		if (TakeHashed(hk, k, v))
+			return true;
+		if (Clock::now() >= deadline)
+			return false;
+		bucket.WaitForAdd(sequence, deadline);
+	}
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL V Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Take(const K& k) noexcept
+{
+	return TakeHashed(ComputeHash(k), k);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Take(const K& k, V& v) noexcept
+{
+	return TakeHashed(ComputeHash(k), k, v);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_RECEIVER_IMPL void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Take(const K& k,
+                                                                                      F&& receiver) noexcept
+{
+	TakeHashed(ComputeHash(k), k, std::forward<F>(receiver));
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename RandomIt>
+size_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::BulkLoad(RandomIt first,
+                                                                 RandomIt last,
+                                                                 uint32_t threads) noexcept
+{
+	typedef typename std::iterator_traits<RandomIt>::iterator_category Category;
+	static_assert(std::is_base_of<std::random_access_iterator_tag, Category>::value,
+	              "BulkLoad requires random access iterators");
+
+	struct Entry
+	{
+		HashType hash;
+		uint32_t record;
+	};
+
+	const size_t n = size_t(last - first);
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+
+	const size_t chunks = std::min<size_t>(n / BULK_LOAD_MIN_CHUNK_SIZE, size_t(threads) * 4);
+	if (chunks <= 1 || n > UINT32_MAX)
+		return AddSequentially(first, last);
+
+	const size_t chunkSize = (n + chunks - 1) / chunks;
+	const uint32_t keyCount = Base::GetKeyCount();
+	const uint32_t partitions = std::clamp(keyCount / BULK_LOAD_PARTITION_BUCKETS, 1U, BULK_LOAD_MAX_PARTITIONS);
+	// Both counts are powers of two, a partition is a range of consecutive buckets
+	const uint32_t shift = CountTrailingZeros(keyCount) - CountTrailingZeros(partitions);
+
+	std::unique_ptr<HashType[]> hashes(new (std::nothrow) HashType[n]);
+	std::unique_ptr<Entry[]> entries(new (std::nothrow) Entry[n]);
+	std::unique_ptr<size_t[]> offsets(new (std::nothrow) size_t[chunks * partitions]);
+	std::unique_ptr<size_t[]> partitionStart(new (std::nothrow) size_t[partitions + 1]);
+	if (!hashes || !entries || !offsets || !partitionStart)
+		return AddSequentially(first, last);
+	std::fill(offsets.get(), offsets.get() + chunks * partitions, size_t(0));
+
+	// Hash and count the records of each partition per chunk...
+	ParallelFor(threads, chunks, [&](const size_t chunk) {
+		size_t* counts = &offsets[chunk * partitions];
+		for (size_t i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i)
+		{
+			hashes[i] = GetKeyHash(first[i].first);
+			++counts[GetCandidateIndex(hashes[i], 0) >> shift];
+		}
+	});
+
+	// ...turn the counts into offsets, partitions are consecutive and chunks are consecutive within them...
+	size_t offset = 0;
+	for (uint32_t partition = 0; partition < partitions; ++partition)
+	{
+		partitionStart[partition] = offset;
+		for (size_t chunk = 0; chunk < chunks; ++chunk)
+		{
+			const size_t count = offsets[chunk * partitions + partition];
+			offsets[chunk * partitions + partition] = offset;
+			offset += count;
+		}
+	}
+	partitionStart[partitions] = offset;
+
+	// ...scatter the records to their partitions...
+	ParallelFor(threads, chunks, [&](const size_t chunk) {
+		size_t* next = &offsets[chunk * partitions];
+		for (size_t i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i)
+			entries[next[GetCandidateIndex(hashes[i], 0) >> shift]++] = Entry{hashes[i], uint32_t(i)};
+	});
+	hashes.reset();
+
+	// ...and fill the buckets one partition at a time
+	std::atomic<size_t> added{0};
+	ParallelFor(threads, partitions, [&](const size_t partition) {
+		size_t count = 0;
+		for (size_t i = partitionStart[partition]; i < partitionStart[partition + 1]; ++i)
+		{
+			const auto& record = first[entries[i].record];
+			count += AddHashed(HashedKey{entries[i].hash, m_seed}, record.first, record.second);
+		}
+		added += count;
+	});
+	return added;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename RandomIt>
+size_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::AddSequentially(RandomIt first, RandomIt last) noexcept
+{
+	size_t added = 0;
+	for (; first != last; ++first)
+		added += Add(first->first, first->second);
+	return added;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL size_t
+    Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ReadMany(const K* keys,
+                                                              const size_t n,
+                                                              V* out,
+                                                              bool* found) noexcept
+{
+	const auto pin = Base::Pin();
+	return ForEachKeyPrefetched(keys, n, found, [&](const size_t i, const HashType h) {
+		return ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.ReadValue(h, keys[i], out[i]); });
+	});
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL size_t
+    Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeMany(const K* keys,
+                                                              const size_t n,
+                                                              V* out,
+                                                              bool* found) noexcept
+{
+	const auto pin = Base::Pin();
+	return ForEachKeyPrefetched(keys, n, found, [&](const size_t i, const HashType h) {
+		KeyValue* pKeyValue = nullptr;
+		if (ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.TakeValue(keys[i], h, &pKeyValue); }))
+		{
+			out[i] = std::move(pKeyValue->v);
+			Base::ReleaseNode(pKeyValue);
+			return true;
+		}
 		return false;
+	});
+}
 
-	const auto h = GetKeyHash(k);
-	const auto index = GetKeyIndex(h);
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+typename Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::HashedKey
+    Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ComputeHash(const K& k) const noexcept
+{
+	return HashedKey{GetKeyHash(k), m_seed};
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::AddHashed(const HashedKey& hk, const K& k, const V& v) noexcept
+{
+	return AddNode(hk, k, [](KeyValue*) {}, v);
+}
 
-	pKeyValue->v = v;
-	pKeyValue->k = KeyHashPair{h, k};
-	if (!m_hash[index].Add(pKeyValue))
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename _K, typename R, typename... Args>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::AddNode(
+    const HashedKey& hk, _K&& k, R&& rollback, Args&&... args) noexcept
+{
+	const auto h = ResolveHash(hk, k);
+	KeyValue* pKeyValue = Base::CreateNode(h, std::forward<_K>(k), std::forward<Args>(args)...);
+	if (pKeyValue == nullptr)
+		return false;
+
+	const auto index = GetPlacementIndex(h);
+	if (m_hash[index].Add(pKeyValue))
+	{
+		m_summary.MarkNonEmpty(index);
+	}
+	else if (!AddToOverflow(index, pKeyValue))
 	{
+		rollback(pKeyValue);
 		Base::ReleaseNode(pKeyValue);
 		return false;
 		// throw std::bad_alloc();
 	}
+
+	if constexpr (IS_INSERT_TAKE(OP_MODE))
+	{
+		// Waiters of TakeWait watch the first candidate bucket, wherever the item was placed
+		m_hash[GetCandidateIndex(h, 0)].NotifyWaiters();
+	}
 	return true;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-MODE_NOT_TAKE_IMPL const V Hash<K, V, _Alloc, OP_MODE>::Read(const K& k) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL const V Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ReadHashed(
+    const HashedKey& hk, const K& k) noexcept
 {
-	const auto h = GetKeyHash(k);
-	const auto index = GetKeyIndex(h);
+	const auto pin = Base::Pin();
+	const auto h = ResolveHash(hk, k);
 	KeyValue* keyVal = nullptr;
-	if (m_hash[index].ReadValue(h, k, &keyVal))
-		return keyVal->v;
-	return V();
+	V v = V();
+	if (ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.ReadValue(h, k, &keyVal); }))
+		keyVal->LoadValue(v);
+	return v;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-MODE_NOT_TAKE_IMPL const bool Hash<K, V, _Alloc, OP_MODE>::Read(const K& k, V& v) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL const bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ReadHashed(
+    const HashedKey& hk, const K& k, V& v) noexcept
 {
-	const auto h = GetKeyHash(k);
-	const auto index = GetKeyIndex(h);
-	return m_hash[index].ReadValue(h, k, v);
+	const auto pin = Base::Pin();
+	const auto h = ResolveHash(hk, k);
+	return ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.ReadValue(h, k, v); });
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-MODE_NOT_TAKE_IMPL void Hash<K, V, _Alloc, OP_MODE>::Read(const K& k,
-                                                          const std::function<bool(const V&)>& receiver) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_RECEIVER_IMPL void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ReadHashed(
+    const HashedKey& hk, const K& k, F&& receiver) noexcept
 {
-	const auto h = GetKeyHash(k);
-	const auto index = GetKeyIndex(h);
-	m_hash[index].ReadValue(h, k, receiver);
+	const auto pin = Base::Pin();
+	const auto h = ResolveHash(hk, k);
+	ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.ReadValues(h, k, receiver); });
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-MODE_TAKE_ONLY_IMPL const V Hash<K, V, _Alloc, OP_MODE>::Take(const K& k) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL V Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeHashed(
+    const HashedKey& hk, const K& k) noexcept
 {
 	V ret = V();
 
-	const auto h = GetKeyHash(k);
-	const auto index = GetKeyIndex(h);
+	const auto pin = Base::Pin();
+	const auto h = ResolveHash(hk, k);
 	KeyValue* pKeyValue = nullptr;
-	if (m_hash[index].TakeValue(k, h, &pKeyValue))
+	if (ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.TakeValue(k, h, &pKeyValue); }))
 	{
 		// Value was found
-		ret = pKeyValue->v;
+		ret = std::move(pKeyValue->v);
 
 		Base::ReleaseNode(pKeyValue);
 	}
 	return ret;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-MODE_TAKE_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE>::Take(const K& k, V& v) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeHashed(
+    const HashedKey& hk, const K& k, V& v) noexcept
 {
-	const auto h = GetKeyHash(k);
-	const auto index = GetKeyIndex(h);
+	const auto pin = Base::Pin();
+	const auto h = ResolveHash(hk, k);
 	KeyValue* pKeyValue = nullptr;
-	if (m_hash[index].TakeValue(k, h, &pKeyValue))
+	if (ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.TakeValue(k, h, &pKeyValue); }))
 	{
 		// Value was found
-		v = pKeyValue->v;
+		v = std::move(pKeyValue->v);
 		Base::ReleaseNode(pKeyValue);
 		return true;
 	}
 	return false;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-MODE_TAKE_ONLY_IMPL void Hash<K, V, _Alloc, OP_MODE>::Take(const K& k,
-                                                           const std::function<bool(const V&)>& receiver) noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_TAKE_ONLY_RECEIVER_IMPL void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::TakeHashed(
+    const HashedKey& hk, const K& k, F&& receiver) noexcept
+{
+	const auto pin = Base::Pin();
+	const auto h = ResolveHash(hk, k);
+	const auto release = [this](KeyValue* pKey) { this->ReleaseNode(pKey); };
+	ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.TakeValues(k, h, receiver, release); });
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_UPDATE_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Upsert(const K& k, const V& v) noexcept
+{
+	return UpdateOrAdd(
+	    k,
+	    [&](KeyValue& node) { node.UpdateValue([&](V& value) { value = v; }); },
+	    [&]() { return v; });
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Update(const K& k, F&& f) noexcept
+{
+	static_assert(IS_INSERT_READ_UPDATE(OP_MODE),
+	              "Only values of MapMode::PARALLEL_INSERT_READ_UPDATE maps are updated in place");
+	return UpdateOrAdd(
+	    k,
+	    [&](KeyValue& node) { node.UpdateValue(f); },
+	    [&]() {
+		    V v = V();
+		    f(v);
+		    return v;
+	    });
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_UPDATE_ONLY_IMPL bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::FetchAdd(const K& k,
+                                                                                     const V& delta,
+                                                                                     V* pPrevious) noexcept
+{
+	static_assert(std::is_arithmetic<V>::value && !std::is_same<V, bool>::value, "FetchAdd requires arithmetic values");
+
+	V previous = V();
+	const bool updated = UpdateOrAdd(
+	    k,
+	    [&](KeyValue& node) {
+		    if constexpr (std::is_integral<V>::value && IsAtomicValue<V>)
+		    {
+			    previous = AtomicRef(node.v).fetch_add(delta, std::memory_order_acq_rel);
+		    }
+		    else
+		    {
+			    node.UpdateValue([&](V& value) {
+				    previous = value;
+				    value += delta;
+			    });
+		    }
+	    },
+	    [&]() { return delta; });
+	if (pPrevious)
+		*pPrevious = previous;
+	return updated;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_ERASE_ONLY_IMPL uint32_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Erase(const K& k) noexcept
+{
+	const auto pin = Base::Pin();
+	const HashType h = GetKeyHash(k);
+	const auto retire = [this](KeyValue* pKeyValue) { this->RetireNode(pKeyValue); };
+
+	// All buckets are visited, since a key may have been added several times
+	uint32_t erased = 0;
+	BucketProbe probe(*this, h);
+	while (Bucket* pBucket = probe.Next())
+	{
+		if (const uint32_t count = pBucket->Erase(h, k, retire))
+		{
+			erased += count;
+			probe.Taken();
+		}
+	}
+	return erased;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_ERASE_ONLY_IMPL uint32_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::Reclaim() noexcept
+{
+	return Base::ReclaimNodes();
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ForEach(F&& visitor) noexcept
+{
+	ParallelForEach(visitor, 1);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ParallelForEach(F&& visitor, const uint32_t threads) noexcept
+{
+	static_assert(!IS_INSERT_TAKE(OP_MODE), "Items of MapMode::PARALLEL_INSERT_TAKE maps are visited by DrainAll");
+	ForEachBucketChunk(threads, [&](const uint32_t first, const uint32_t last) {
+		const auto pin = Base::Pin();
+		for (uint32_t i = first; i < last; ++i)
+			m_hash[i].ForEachItem(visitor);
+	});
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+size_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::DrainAll(F&& visitor, const uint32_t threads) noexcept
+{
+	static_assert(IS_INSERT_TAKE(OP_MODE), "Only items of MapMode::PARALLEL_INSERT_TAKE maps can be drained");
+	std::atomic<size_t> drained{0};
+	const auto release = [this](KeyValue* pKeyValue) { this->ReleaseNode(pKeyValue); };
+	ForEachBucketChunk(threads, [&](const uint32_t first, const uint32_t last) {
+		const auto pin = Base::Pin();
+		size_t count = 0;
+		for (uint32_t i = first; i < last; ++i)
+			count += m_hash[i].TakeAll(visitor, release);
+		drained += count;
+	});
+	return drained;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+MODE_NOT_TAKE_IMPL typename Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::KeyValue*
+    Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::FindNode(const HashType h, const K& k) noexcept
+{
+	KeyValue* pKeyValue = nullptr;
+	if (ForEachCandidateBucket(h, [&](Bucket& bucket) { return bucket.ReadValue(h, k, &pKeyValue); }))
+		return pKeyValue;
+	return nullptr;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename U, typename M>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::UpdateOrAdd(const K& k, U&& update, M&& make) noexcept
 {
 	const auto h = GetKeyHash(k);
-	const auto index = GetKeyIndex(h);
-	const auto release = [=](KeyValue* pKey) { this->ReleaseNode(pKey); };
-	m_hash[index].TakeValue(k, h, receiver, release);
+	KeyValue* pKeyValue = FindNode(h, k);
+	if (!pKeyValue)
+	{
+		// Key is absent, check again under the lock in case another thread added it meanwhile
+		std::lock_guard<std::mutex> guard(m_upsertLocks[h]);
+		pKeyValue = FindNode(h, k);
+		if (!pKeyValue)
+			return AddNode(HashedKey{h, m_seed}, k, [](KeyValue*) {}, make());
+	}
+
+	// Items are never removed, so the node stays in the map
+	update(*pKeyValue);
+	return true;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-constexpr const bool Hash<K, V, _Alloc, OP_MODE>::IsAlwaysLockFree() noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+constexpr const bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::IsAlwaysLockFree() noexcept
 {
 	return KeyValue::IsAlwaysLockFree();
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
 constexpr const MapMode GetMapMode() noexcept
 {
 	return OP_MODE;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-bool Hash<K, V, _Alloc, OP_MODE>::IsLockFree() const noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::IsLockFree() const noexcept
 {
 	if constexpr (IsAlwaysLockFree())
 	{
@@ -310,22 +1175,216 @@ bool Hash<K, V, _Alloc, OP_MODE>::IsLockFree() const noexcept
 	}
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-inline constexpr MapMode Hash<K, V, _Alloc, OP_MODE>::GetMapMode() noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+inline constexpr MapMode Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetMapMode() noexcept
 {
 	return OP_MODE;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-uint32_t Hash<K, V, _Alloc, OP_MODE>::GetKeyHash(const K& k) const noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+typename Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::HashType
+    Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetKeyHash(const K& k) const noexcept
 {
-	const uint32_t h = hash(k, m_seed);
+	const HashType h = m_hasher(k);
 	return h;
 }
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
-uint32_t Hash<K, V, _Alloc, OP_MODE>::GetKeyIndex(const uint32_t hash) const noexcept
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+typename Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::HashType
+    Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ResolveHash(const HashedKey& hk, const K& k) const noexcept
 {
-	const uint32_t index = (hash % Base::GetKeyCount());
+	if (hk.seed != m_seed)
+		return GetKeyHash(k);
+
+	assert(hk.hash == GetKeyHash(k));
+	return hk.hash;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint32_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetKeyIndex(const HashType hash) const noexcept
+{
+	// Key count is a power of two
+	const uint32_t index = uint32_t(hash & Base::GetKeyMask());
 	return index;
 }
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint32_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetNeighbourIndex(const uint32_t index,
+                                                                            const uint32_t distance) const noexcept
+{
+	return (index + distance) & Base::GetKeyMask();
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint32_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetCandidateIndex(const HashType hash,
+                                                                            const uint32_t choice) const noexcept
+{
+	const uint32_t index = GetKeyIndex(hash);
+	if (choice == 0)
+		return index;
+
+	if constexpr (PLACEMENT == BucketPlacement::TWO_CHOICE)
+	{
+		// Second candidate is selected by bits which are independent of the first index
+		const uint32_t second = GetKeyIndex(MixBits(hash));
+		if (choice == 1 && second != index)
+			return second;
+	}
+	return ~0U;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+uint32_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::GetPlacementIndex(const HashType hash) const noexcept
+{
+	const uint32_t first = GetCandidateIndex(hash, 0);
+	if constexpr (PLACEMENT == BucketPlacement::TWO_CHOICE)
+	{
+		const uint32_t second = GetCandidateIndex(hash, 1);
+		if (second != ~0U && m_hash[second].GetUsage() < m_hash[first].GetUsage())
+			return second;
+	}
+	return first;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ForEachCandidateBucket(const HashType hash, F&& f) noexcept
+{
+	// Items overflow only from full buckets, other buckets pay just for reading the overflow hint. After a bucket has
+	// overflown, a miss scans the buckets up to the hint. Take modes lower the hint once the farthest overflown item
+	// is taken, and erase mode once it's erased (see Erase), other modes never remove items.
+	BucketProbe probe(*this, hash);
+	while (Bucket* pBucket = probe.Next())
+	{
+		if (f(*pBucket))
+		{
+			if constexpr (IS_INSERT_TAKE(OP_MODE))
+				probe.Taken();
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ForEachBucketChunk(const uint32_t threads, F&& f) noexcept
+{
+	const uint32_t keyCount = Base::GetKeyCount();
+	const size_t chunks = (size_t(keyCount) + FOR_EACH_CHUNK_BUCKETS - 1) / FOR_EACH_CHUNK_BUCKETS;
+	ParallelFor(threads, chunks, [&](const size_t chunk) {
+		const uint32_t first = uint32_t(chunk * FOR_EACH_CHUNK_BUCKETS);
+		f(first, std::min(keyCount, first + FOR_EACH_CHUNK_BUCKETS));
+	});
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+template <typename F>
+size_t Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ForEachKeyPrefetched(const K* keys,
+                                                                                const size_t n,
+                                                                                bool* found,
+                                                                                F&& lookup) noexcept
+{
+	size_t count = 0;
+	HashType hashes[LOOKUP_BATCH_SIZE];
+	for (size_t first = 0; first < n; first += LOOKUP_BATCH_SIZE)
+	{
+		const size_t size = (n - first < LOOKUP_BATCH_SIZE) ? (n - first) : LOOKUP_BATCH_SIZE;
+
+		// Hash the group and prefetch the buckets...
+		for (size_t i = 0; i < size; ++i)
+		{
+			hashes[i] = GetKeyHash(keys[first + i]);
+			m_hash[GetCandidateIndex(hashes[i], 0)].Prefetch();
+			if constexpr (PLACEMENT == BucketPlacement::TWO_CHOICE)
+			{
+				const uint32_t second = GetCandidateIndex(hashes[i], 1);
+				if (second != ~0U)
+					m_hash[second].Prefetch();
+			}
+		}
+
+		// ...then the nodes, whose fingerprints match...
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_hash[GetCandidateIndex(hashes[i], 0)].PrefetchCandidates(hashes[i]);
+			if constexpr (PLACEMENT == BucketPlacement::TWO_CHOICE)
+			{
+				const uint32_t second = GetCandidateIndex(hashes[i], 1);
+				if (second != ~0U)
+					m_hash[second].PrefetchCandidates(hashes[i]);
+			}
+		}
+
+		// ...and finally compare the keys
+		for (size_t i = 0; i < size; ++i)
+		{
+			const bool hit = lookup(first + i, hashes[i]);
+			count += hit;
+			if (found)
+				found[first + i] = hit;
+		}
+	}
+	return count;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+bool Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::AddToOverflow(const uint32_t index, KeyValue* pKeyValue) noexcept
+{
+	const uint32_t farthest = std::min(Base::GetKeyCount() - 1, OVERFLOW_MAX_DISTANCE);
+	for (uint32_t distance = 1; distance <= farthest; ++distance)
+	{
+		// Hint is raised before the item is published, so that readers never miss it
+		m_hash[index].RaiseOverflow(distance);
+		const uint32_t neighbour = GetNeighbourIndex(index, distance);
+		if (m_hash[neighbour].Add(pKeyValue))
+		{
+			// ShrinkOverflow may have lowered the hint before it saw the item, raising it again fails the lowering or
+			// restores the hint
+			if constexpr (IS_INSERT_TAKE(OP_MODE) || IS_INSERT_READ_ERASE(OP_MODE))
+				m_hash[index].RaiseOverflow(distance);
+			m_summary.MarkNonEmpty(neighbour);
+			return true;
+		}
+	}
+
+	// No bucket had room, so the hint is lowered back to the items, which were overflown before
+	if constexpr (!IS_INSERT_READ_FROM_HEAP(OP_MODE))
+	{
+		const auto pin = Base::Pin();
+		ShrinkOverflow(index);
+	}
+	return false;
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ShrinkOverflow(const uint32_t index) noexcept
+{
+	Bucket& bucket = m_hash[index];
+	const uint32_t observed = bucket.GetOverflowState();
+	const uint32_t overflow = observed & OVERFLOW_MAX_DISTANCE;
+
+	// Items of both candidate buckets count, since a second candidate may overflow over the first
+	const auto overflownFrom = [&](const HashType hash) {
+		return GetCandidateIndex(hash, 0) == index || GetCandidateIndex(hash, 1) == index;
+	};
+	uint32_t farthest = overflow;
+	while (farthest > 0 && !m_hash[GetNeighbourIndex(index, farthest)].MayHold(overflownFrom))
+		--farthest;
+
+	// Fails, if an item was overflown meanwhile
+	if (farthest < overflow)
+		bucket.LowerOverflow(observed, farthest);
+}
+
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, BucketPlacement PLACEMENT, typename _Hasher>
+void Hash<K, V, _Alloc, OP_MODE, PLACEMENT, _Hasher>::ShrinkOverflowOf(const HashType hash, const uint32_t index) noexcept
+{
+	for (uint32_t choice = 0; choice < 2; ++choice)
+	{
+		const uint32_t candidate = GetCandidateIndex(hash, choice);
+		if (candidate != ~0U && candidate != index &&
+		    m_hash[candidate].GetOverflow() == ((index - candidate) & Base::GetKeyMask()))
+			ShrinkOverflow(candidate);
+	}
+}
@@ -7,7 +7,29 @@ class HashIterator
 	typedef typename _Hash::KeyType K;
 	typedef typename _Hash::ValueType V;
 	typedef typename _Hash::Bucket Bucket;
-	typedef typename Bucket::Iterator Iterator;
+	typedef typename _Hash::HashType HashType;
+	typedef typename _Hash::KeyValue KeyValue;
+	typedef typename _Hash::BucketProbe BucketProbe;
+
+	//! \brief Returns nodes taken by the bucket iterator to the map, a plain functor so the call is inlined
+	struct NodeReleaser
+	{
+		_Hash* pHash;
+
+		inline void operator()(KeyValue* pKeyValue) const noexcept
+		{
+			pHash->ReleaseNode(pKeyValue);
+		}
+	};
+	typedef typename Bucket::template IteratorOf<NodeReleaser> Iterator;
+
+	// Value returns a reference in to the node, which the iterator doesn't keep pinned, see Hash::Find
+	static_assert(!std::is_same<typename _Hash::MODE, MODE_INSERT_READ_ERASE>::value,
+	              "HashIterator is not available in MapMode::PARALLEL_INSERT_READ_ERASE, the value of an erased item "
+	              "would be recycled under the reference, use Hash::Read");
+	static_assert(!(std::is_same<typename _Hash::MODE, MODE_INSERT_READ_UPDATE>::value && IsSeqLockedValue<V>),
+	              "HashIterator would read values, which Upsert and Update write under a seqlock, without the "
+	              "seqlock, use Hash::Read");
 
 public:
 	explicit HashIterator(_Hash& hash) noexcept;
@@ -33,11 +55,11 @@ private:
 	_Hash& _hash;
 	Iterator _iter;
 	K _k;
-	uint32_t _h;
+	HashType _h;
+	BucketProbe _probe; // Buckets, which may hold items of the key being iterated
 	typename _Hash::Bucket* _bucket;
 	typename _Hash::KeyValue* _keyValue;
 
-	std::function<void(typename _Hash::KeyValue*)> _release;
 #if defined(_DEBUG) || defined(VALIDATE_ITERATOR_NON_CONCURRENT_ACCESS)
 	std::atomic<uint32_t> _counter;
 #endif // !_DEBUG
@@ -47,6 +69,7 @@ template <typename _Hash>
 HashIterator<_Hash>::HashIterator(_Hash& hash) noexcept
     : _hash(hash)
     , _h(0)
+    , _probe(hash, 0)
     , _bucket(nullptr)
     , _keyValue(nullptr)
 {
@@ -68,9 +91,8 @@ HashIterator<_Hash>& HashIterator<_Hash>::SetKey(const K& k) noexcept
 
 	_k = k;
 	_h = _hash.GetKeyHash(k);
-	const auto index = _hash.GetKeyIndex(_h);
-
-	_bucket = &_hash.m_hash[index];
+	_probe = BucketProbe(_hash, _h);
+	_bucket = _probe.Next();
 
 	SetIter();
 	return *this;
@@ -81,6 +103,8 @@ template <typename _Hash>
 HashIterator<_Hash>& HashIterator<_Hash>::Reset() noexcept
 {
 	CHECK_CONCURRENT_ACCESS(_counter);
+	_probe = BucketProbe(_hash, _h);
+	_bucket = _probe.Next();
 	SetIter();
 	return *this;
 }
@@ -90,7 +114,20 @@ bool HashIterator<_Hash>::Next() noexcept
 {
 	CHECK_CONCURRENT_ACCESS(_counter);
 	TRACE(typeid(Iterator).name(), " Next()");
-	return _iter.Next();
+	// Nodes taken by the bucket iterator are released while the map is pinned
+	const auto pin = _hash.Pin();
+	while (!_iter.Next())
+	{
+		// Continue to the buckets where the candidate bucket has overflown, then to the next candidate
+		_bucket = _probe.Next();
+		if (_bucket == nullptr)
+			return false;
+		SetIter();
+	}
+
+	if constexpr (std::is_same<typename _Hash::MODE, MODE_INSERT_TAKE>::value)
+		_probe.Taken();
+	return true;
 }
 
 template <typename _Hash>
@@ -120,6 +157,5 @@ template <typename _Hash>
 MODE_TAKE_ONLY_IMPL void HashIterator<_Hash>::SetIter() noexcept
 {
 	TRACE(typeid(Iterator).name(), " SetIter()");
-	_release = [=](typename _Hash::KeyValue* pKey) { _hash.ReleaseNode(pKey); };
-	_iter = Iterator(_bucket, _h, _k, _release);
+	_iter = Iterator(_bucket, _h, _k, NodeReleaser{&_hash});
 }
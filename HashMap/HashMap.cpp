@@ -5,15 +5,23 @@
 #include <string>
 #include "Hash.h"
 #include "HashIterator.h"
+#include "GrowableHash.h"
+#include "InterleavedLookup.h"
+#include <algorithm>
 #include <chrono>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <mutex>
 #include <future>
+#include <thread>
+#include <vector>
 
 template <typename Hash>
 void TestHash(Hash& a);
 void someTests();
+void RunBenchmarks();
+bool RunFunctionalTests();
 
 struct TT
 {
@@ -55,6 +63,7 @@ constexpr static const HashMemAllocator HashAllocator = HashMemAllocator::STATIC
 constexpr static const bool validateWithIterators = 0;
 constexpr static const bool validateForExtraItems = false;
 constexpr static const uint8_t THREADS = 1;
+constexpr static const bool runBenchmarks = false;
 
 constexpr static const char* TESTED[SUT_SIZE] = {"std::unordered_multimap",
                                                  "Hash(insert take)",
@@ -369,6 +378,15 @@ constexpr static const MapMode GetMapMode()
 
 int main()
 {
+	if constexpr (runBenchmarks)
+	{
+		RunBenchmarks();
+		return 0;
+	}
+
+	if (!RunFunctionalTests())
+		return -1;
+
 	try
 	{
 		auto iters = 0;
@@ -510,31 +528,6 @@ bool operator==(const TT& o, const TT& t)
 	return o.a == t.a && o.b == t.b && o.c == t.c;
 }
 
-template <>
-uint32_t hash(const TT& k, const uint32_t seed)
-{
-	const TT* k_ = &k;
-	const uint64_t* val = (uint64_t*)k_;
-	std::cout << " hashing " << k.toString() << " hash: " << hash(*val, seed) << " seed:" << seed << std::endl;
-	//_Test<1, std::integral_constant, int> a;
-	return hash(*val, seed);
-}
-
-template <>
-uint32_t hash(const std::string& s, const uint32_t seed)
-{
-#define FNV_PRIME_32 16777619
-#define FNV_OFFSET_BASIS_32 2166136261
-
-	uint32_t fnv = FNV_OFFSET_BASIS_32;
-	for (uint32_t i = 0; i < s.size(); ++i)
-	{
-		fnv = fnv ^ (s[i]);
-		fnv = fnv * FNV_PRIME_32;
-	}
-	return hash(fnv, seed);
-}
-
 template <typename Hash>
 void TestHash(Hash& a)
 {
@@ -697,6 +690,1018 @@ void someTests()
 	std::cout << "Hello World!\n";
 }
 
+// Runs \p f(threadIndex) on \p threads threads in parallel, returns the wall-clock time taken by all threads
+template <typename F>
+static std::chrono::nanoseconds RunInParallel(const uint32_t threads, F&& f)
+{
+	std::vector<std::thread> workers;
+	std::atomic<uint32_t> ready{0};
+	std::atomic<bool> go{false};
+	for (uint32_t t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&, t]() {
+			++ready;
+			while (!go)
+				std::this_thread::yield();
+			f(t);
+		});
+	}
+	while (ready != threads)
+		std::this_thread::yield();
+
+	auto start = std::chrono::steady_clock::now();
+	go = true;
+	for (auto& w : workers)
+		w.join();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+}
+
+static double MillionOpsPerSecond(const uint64_t ops, const std::chrono::nanoseconds duration)
+{
+	return double(ops) / double(duration.count()) * 1000.0;
+}
+
+// Add+Take throughput at different fill levels of the map, shows the cost of acquiring and releasing nodes
+static void BenchmarkAddTakeOccupancy()
+{
+	constexpr uint32_t ELEMENTS = 1 << 20;
+	constexpr uint32_t OPS_PER_THREAD = 1 << 20;
+	const uint32_t threads = std::max(1U, std::thread::hardware_concurrency());
+
+	for (const uint32_t occupancy : {10, 50, 95})
+	{
+		Hash<int, int, HeapAllocator<32>> map(ELEMENTS);
+		const uint32_t prefill = ELEMENTS / 100 * occupancy;
+		for (uint32_t i = 0; i < prefill; ++i)
+			map.Add(int(i), int(i));
+
+		const auto duration = RunInParallel(threads, [&map](const uint32_t thread) {
+			const int key = int(ELEMENTS + thread);
+			for (uint32_t i = 0; i < OPS_PER_THREAD; ++i)
+			{
+				map.Add(key, int(i));
+				map.Take(key);
+			}
+		});
+		std::cout << "Add+Take, occupancy " << occupancy << "%, " << threads << " threads: "
+		          << MillionOpsPerSecond(uint64_t(OPS_PER_THREAD) * threads, duration) << " Mops/s" << std::endl;
+	}
+}
+
+// Add+Take throughput for 1..N threads, with and without per-thread node magazines
+template <typename Alloc>
+static void BenchmarkAddTakeScaling(const char* name)
+{
+	constexpr uint32_t ELEMENTS = 1 << 16;
+	constexpr uint32_t OPS_PER_THREAD = 1 << 20;
+	constexpr uint32_t KEYS_PER_THREAD = 16;
+	const uint32_t maxThreads = std::max(1U, std::thread::hardware_concurrency());
+
+	for (uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		Hash<int, int, Alloc> map(ELEMENTS);
+		const auto duration = RunInParallel(threads, [&map](const uint32_t thread) {
+			const int firstKey = int(thread * KEYS_PER_THREAD);
+			for (uint32_t i = 0; i < OPS_PER_THREAD; i += KEYS_PER_THREAD)
+			{
+				for (int k = 0; k < int(KEYS_PER_THREAD); ++k)
+					map.Add(firstKey + k, k);
+				for (int k = 0; k < int(KEYS_PER_THREAD); ++k)
+					map.Take(firstKey + k);
+			}
+		});
+		std::cout << name << ", " << threads << " threads: "
+		          << MillionOpsPerSecond(uint64_t(OPS_PER_THREAD) * threads, duration) << " Mops/s" << std::endl;
+	}
+}
+
+// Insert and lookup latency of MapMode::PARALLEL_INSERT_READ_GROW_FROM_HEAP, where nodes are allocated at insertion
+static void BenchmarkGrowFromHeap()
+{
+	constexpr uint32_t KEY_COUNT = 1 << 12;
+	constexpr uint32_t ITEMS = 1 << 20;
+
+	Hash<int, int, HeapAllocator<0>> map(KEY_COUNT);
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ITEMS; ++i)
+		map.Add(int(i), int(i));
+	const auto insert = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	int64_t sum = 0;
+	for (uint32_t i = 0; i < ITEMS; i += 64)
+		sum += map.Read(int(i));
+	const auto read = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Grow from heap, insert: "
+	          << std::chrono::duration_cast<std::chrono::nanoseconds>(insert).count() / ITEMS << " ns/item, read: "
+	          << std::chrono::duration_cast<std::chrono::nanoseconds>(read).count() / (ITEMS / 64) << " ns/item ("
+	          << sum << ")" << std::endl;
+}
+
+// Key, which is placed in a chosen bucket, used for filling buckets up to their capacity
+struct BucketKey
+{
+	uint32_t bucket;
+	uint32_t id;
+};
+
+bool operator==(const BucketKey& a, const BucketKey& b)
+{
+	return a.bucket == b.bucket && a.id == b.id;
+}
+
+uint32_t hash(const BucketKey& k, const uint32_t /*seed*/)
+{
+	// Low bits select the bucket, high bits differ per key
+	return k.bucket | ((k.id * 0x9E3779B1) & 0xFF000000);
+}
+
+// Lookup latency of hits and misses in full buckets
+template <uint32_t COLLISION_SIZE>
+static void BenchmarkLookupLatency()
+{
+	constexpr uint32_t ELEMENTS = 1 << 18;
+	constexpr uint32_t LOOKUPS = 1 << 22;
+	constexpr uint32_t FULL_BUCKETS = ELEMENTS / COLLISION_SIZE;
+
+	Hash<BucketKey, int, HeapAllocator<COLLISION_SIZE>, MapMode::PARALLEL_INSERT_READ> map(ELEMENTS);
+	for (uint32_t bucket = 0; bucket < FULL_BUCKETS; ++bucket)
+		for (uint32_t id = 0; id < COLLISION_SIZE; ++id)
+			map.Add({bucket * 2, id}, int(id));
+
+	std::mt19937 engine{1};
+	std::vector<BucketKey> keys(LOOKUPS);
+	for (auto& key : keys)
+		key = {uint32_t(engine() % FULL_BUCKETS) * 2, uint32_t(engine() % COLLISION_SIZE)};
+
+	for (const bool hit : {true, false})
+	{
+		const uint32_t idOffset = hit ? 0 : COLLISION_SIZE; // Missing keys land to the same full buckets
+		int v = 0;
+		uint32_t found = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& key : keys)
+			found += map.Read({key.bucket, key.id + idOffset}, v);
+		const auto duration = std::chrono::steady_clock::now() - start;
+		std::cout << "Lookup " << (hit ? "hit" : "miss") << ", COLLISION_SIZE " << COLLISION_SIZE << ": "
+		          << double(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / LOOKUPS
+		          << " ns (found " << found << ")" << std::endl;
+	}
+}
+
+// Insert and lookup latency of a full map with small buckets, with single and two-choice bucket placement
+template <uint32_t COLLISION_SIZE, BucketPlacement PLACEMENT>
+static void BenchmarkPlacement(const char* name)
+{
+	constexpr uint32_t ELEMENTS = 1 << 20;
+
+	std::mt19937 engine{1};
+	std::vector<int> keys(ELEMENTS);
+	for (auto& key : keys)
+		key = int(engine() & 0x7FFFFFFF);
+
+	Hash<int, int, HeapAllocator<COLLISION_SIZE>, MapMode::PARALLEL_INSERT_READ, PLACEMENT> map(ELEMENTS);
+	uint32_t added = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (const int key : keys)
+		added += map.Add(key, key);
+	const auto insert = std::chrono::steady_clock::now() - start;
+
+	int v = 0;
+	uint32_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for (const int key : keys)
+		found += map.Read(key, v);
+	const auto hit = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (const int key : keys)
+		found += map.Read(-1 - key, v);
+	const auto miss = std::chrono::steady_clock::now() - start;
+
+	std::cout << name << ", COLLISION_SIZE " << COLLISION_SIZE << ", insert: "
+	          << std::chrono::duration_cast<std::chrono::nanoseconds>(insert).count() / ELEMENTS << " ns, hit: "
+	          << std::chrono::duration_cast<std::chrono::nanoseconds>(hit).count() / ELEMENTS << " ns, miss: "
+	          << std::chrono::duration_cast<std::chrono::nanoseconds>(miss).count() / ELEMENTS << " ns (added "
+	          << added << ", found " << found << ")" << std::endl;
+}
+
+// Insert (including construction) and take latency of a map growing online from a small capacity, compared to
+// a map sized for the peak
+template <typename Map>
+static void BenchmarkGrowable(const char* name, const uint32_t capacity)
+{
+	constexpr uint32_t ELEMENTS = 1 << 20;
+
+	auto start = std::chrono::steady_clock::now();
+	Map map(capacity);
+	uint32_t added = 0;
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		added += map.Add(int(i), int(i));
+	const auto insert = std::chrono::steady_clock::now() - start;
+
+	int v = 0;
+	uint32_t taken = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		taken += map.Take(int(i), v);
+	const auto take = std::chrono::steady_clock::now() - start;
+
+	std::cout << name << ", insert: " << std::chrono::duration_cast<std::chrono::nanoseconds>(insert).count() / ELEMENTS
+	          << " ns, take: " << std::chrono::duration_cast<std::chrono::nanoseconds>(take).count() / ELEMENTS
+	          << " ns (added " << added << ", taken " << taken << ")" << std::endl;
+}
+
+// Bucket occupancy and hashing speed of the previous identity hash and the default hash over several key sets
+static void BenchmarkHashDistribution()
+{
+	constexpr uint32_t ELEMENTS = 1 << 18;
+	constexpr uint32_t KEY_COUNT = ComputeHashKeyCount(ELEMENTS);
+	const uint32_t seed = GenerateSeed();
+
+	std::mt19937 engine{1};
+	const std::pair<const char*, std::function<int(uint32_t)>> keySets[] = {
+	    {"sequential", [](const uint32_t i) { return int(i); }},
+	    {"strided", [](const uint32_t i) { return int(((i / 4096) << 24) | (i % 4096)); }},
+	    {"random", [&engine](const uint32_t) { return int(engine()); }},
+	    {"adversarial", [](const uint32_t i) { return int(i << 13); }}}; // Low bits are equal
+	const std::pair<const char*, std::function<uint32_t(int)>> functions[] = {
+	    {"identity", [seed](const int k) { return uint32_t(k) ^ seed; }},
+	    {"default", [seed](const int k) { return hash(k, seed); }}};
+
+	for (const auto& keySet : keySets)
+	{
+		std::vector<int> keys(ELEMENTS);
+		for (uint32_t i = 0; i < ELEMENTS; ++i)
+			keys[i] = keySet.second(i);
+
+		for (const auto& function : functions)
+		{
+			std::vector<uint32_t> occupancy(KEY_COUNT);
+			uint32_t maxOccupancy = 0;
+			uint32_t overflown = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (const int key : keys)
+			{
+				const uint32_t count = ++occupancy[function.second(key) % KEY_COUNT];
+				maxOccupancy = std::max(maxOccupancy, count);
+				overflown += count > DEFAULT_COLLISION_SIZE;
+			}
+			const auto duration = std::chrono::steady_clock::now() - start;
+			std::cout << "Hash " << function.first << ", " << keySet.first << " keys: max bucket occupancy "
+			          << maxOccupancy << ", overflown " << overflown << ", "
+			          << double(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / ELEMENTS
+			          << " ns/key" << std::endl;
+		}
+	}
+}
+
+// Insert and lookup latency with the hash policies of Hash
+template <typename Hasher>
+static void BenchmarkHasher(const char* name)
+{
+	constexpr uint32_t ELEMENTS = 1 << 20;
+
+	Hash<int, int, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ, BucketPlacement::SINGLE, Hasher> map(ELEMENTS);
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		map.Add(int(i), int(i));
+	const auto insert = std::chrono::steady_clock::now() - start;
+
+	int v = 0;
+	uint32_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		found += map.Read(int(i), v);
+	const auto read = std::chrono::steady_clock::now() - start;
+
+	std::cout << name << ", insert: " << std::chrono::duration_cast<std::chrono::nanoseconds>(insert).count() / ELEMENTS
+	          << " ns, read: " << std::chrono::duration_cast<std::chrono::nanoseconds>(read).count() / ELEMENTS
+	          << " ns (found " << found << ")" << std::endl;
+}
+
+// Lookup latency of random keys in a table of 2^25 buckets, i.e. where a 32-bit hash has no bits to spare
+template <typename Hasher>
+static void BenchmarkLargeTable(const char* name)
+{
+	constexpr uint32_t ELEMENTS = 1 << 24;
+	constexpr uint32_t LOOKUPS = 1 << 22;
+
+	Hash<uint64_t, int, HeapAllocator<4>, MapMode::PARALLEL_INSERT_READ, BucketPlacement::SINGLE, Hasher> map(
+	    ELEMENTS);
+	uint32_t added = 0;
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		added += map.Add(uint64_t(i) * HASH_PRIME64_3, int(i));
+
+	std::mt19937 engine{1};
+	std::vector<uint64_t> keys(LOOKUPS);
+	for (auto& key : keys)
+		key = uint64_t(engine() % ELEMENTS) * HASH_PRIME64_3;
+
+	for (const bool hit : {true, false})
+	{
+		const uint64_t keyOffset = hit ? 0 : 1; // Missing keys are never multiples of the odd constant
+		int v = 0;
+		uint32_t found = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& key : keys)
+			found += map.Read(key + keyOffset, v);
+		const auto duration = std::chrono::steady_clock::now() - start;
+		std::cout << name << ", " << ComputeHashKeyCount(ELEMENTS) << " buckets, " << added << " items, lookup "
+		          << (hit ? "hit" : "miss") << ": "
+		          << double(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / LOOKUPS
+		          << " ns (found " << found << ")" << std::endl;
+	}
+}
+
+// Lookup throughput of random keys with ReadMany in batches of various sizes, against single Read calls
+static void BenchmarkReadMany()
+{
+	constexpr uint32_t ELEMENTS = 1 << 21;
+	constexpr uint32_t LOOKUPS = 1 << 22;
+
+	Hash<uint32_t, int, HeapAllocator<8>, MapMode::PARALLEL_INSERT_READ> map(ELEMENTS);
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		map.Add(i * 2, int(i));
+
+	std::mt19937 engine{1};
+	std::vector<uint32_t> keys(LOOKUPS);
+	for (auto& key : keys)
+		key = engine() % (ELEMENTS * 2); // Half of the keys are missing
+	std::vector<int> values(LOOKUPS);
+
+	uint32_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < LOOKUPS; ++i)
+		found += map.Read(keys[i], values[i]);
+	auto duration = std::chrono::steady_clock::now() - start;
+	std::cout << "Read: " << MillionOpsPerSecond(LOOKUPS, duration) << " Mops/s (found " << found << ")"
+	          << std::endl;
+
+	for (const uint32_t batch : {4, 16, 64, 256})
+	{
+		found = 0;
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < LOOKUPS; i += batch)
+			found += uint32_t(map.ReadMany(&keys[i], batch, &values[i]));
+		duration = std::chrono::steady_clock::now() - start;
+		std::cout << "ReadMany, batch " << batch << ": " << MillionOpsPerSecond(LOOKUPS, duration)
+		          << " Mops/s (found " << found << ")" << std::endl;
+	}
+}
+
+// Per-call cost of a std::function receiver against a lambda, which is inlined into the bucket scan
+static void BenchmarkReceiver()
+{
+	constexpr uint32_t ELEMENTS = 1 << 16;
+	constexpr uint32_t LOOKUPS = 1 << 24;
+
+	Hash<uint32_t, int, HeapAllocator<8>, MapMode::PARALLEL_INSERT_READ> map(ELEMENTS);
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		map.Add(i, int(i));
+
+	int64_t sum = 0;
+	const std::function<bool(const int&)> function = [&](const int& v) {
+		sum += v;
+		return true;
+	};
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < LOOKUPS; ++i)
+		map.Read(i % ELEMENTS, function);
+	auto duration = std::chrono::steady_clock::now() - start;
+	std::cout << "Read, std::function receiver: " << MillionOpsPerSecond(LOOKUPS, duration) << " Mops/s (sum " << sum
+	          << ")" << std::endl;
+
+	sum = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < LOOKUPS; ++i)
+		map.Read(i % ELEMENTS, [&](const int& v) {
+			sum += v;
+			return true;
+		});
+	duration = std::chrono::steady_clock::now() - start;
+	std::cout << "Read, lambda receiver: " << MillionOpsPerSecond(LOOKUPS, duration) << " Mops/s (sum " << sum << ")"
+	          << std::endl;
+}
+
+// Work pool throughput of TakeAny, with half of the threads adding items and the other half taking any of them, and
+// latency of TakeAny in a large map holding only a few items
+static void BenchmarkTakeAny()
+{
+	constexpr uint32_t ELEMENTS = 1 << 20;
+	constexpr uint32_t ITEMS_PER_PRODUCER = 1 << 18;
+	const uint32_t threads = std::max(2U, std::thread::hardware_concurrency());
+	const uint32_t producers = threads / 2;
+	const uint64_t items = uint64_t(ITEMS_PER_PRODUCER) * producers;
+
+	{
+		Hash<uint32_t, uint32_t, HeapAllocator<32>> map(ELEMENTS);
+		std::atomic<uint64_t> consumed{0};
+		const auto duration = RunInParallel(threads, [&](const uint32_t thread) {
+			if (thread < producers)
+			{
+				for (uint32_t i = 0; i < ITEMS_PER_PRODUCER; ++i)
+				{
+					while (!map.Add(thread * ITEMS_PER_PRODUCER + i, i))
+						std::this_thread::yield(); // Map is full, let the consumers catch up
+				}
+			}
+			else
+			{
+				uint32_t k = 0;
+				uint32_t v = 0;
+				while (consumed.load(std::memory_order_relaxed) < items)
+				{
+					if (map.TakeAny(k, v))
+						consumed.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		});
+		std::cout << "TakeAny work pool, " << producers << " producers, " << threads - producers
+		          << " consumers: " << MillionOpsPerSecond(items, duration) << " Mops/s" << std::endl;
+	}
+
+	{
+		constexpr uint32_t SPARSE_ITEMS = 16;
+		constexpr uint32_t OPS = 1 << 20;
+		Hash<uint32_t, uint32_t, HeapAllocator<8>> map(1 << 24);
+		for (uint32_t i = 0; i < SPARSE_ITEMS; ++i)
+			map.Add(i, i);
+
+		uint32_t k = 0;
+		uint32_t v = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < OPS; ++i)
+		{
+			map.TakeAny(k, v);
+			map.Add(k, v);
+		}
+		const auto duration = std::chrono::steady_clock::now() - start;
+		std::cout << "TakeAny+Add, " << SPARSE_ITEMS << " items in 2^24 slots: " << MillionOpsPerSecond(OPS, duration)
+		          << " Mops/s" << std::endl;
+	}
+}
+
+#ifdef HASH_COROUTINES
+// Lookup throughput of random keys with Read, ReadMany and InterleavedLookup in batches of 256 keys
+template <typename Map>
+static void BenchmarkInterleaved(const char* name, Map& map, const uint32_t elements)
+{
+	constexpr uint32_t LOOKUPS = 1 << 22;
+	constexpr uint32_t BATCH = 256;
+
+	for (uint32_t i = 0; i < elements; ++i)
+		map.Add(i * 2, int(i));
+
+	std::mt19937 engine{1};
+	std::vector<uint32_t> keys(LOOKUPS);
+	for (auto& key : keys)
+		key = engine() % (elements * 2); // Half of the keys are missing
+	std::vector<int> values(LOOKUPS);
+
+	uint32_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < LOOKUPS; ++i)
+		found += map.Read(keys[i], values[i]);
+	auto duration = std::chrono::steady_clock::now() - start;
+	std::cout << name << ", Read: " << MillionOpsPerSecond(LOOKUPS, duration) << " Mops/s (found " << found << ")"
+	          << std::endl;
+
+	found = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < LOOKUPS; i += BATCH)
+		found += uint32_t(map.ReadMany(&keys[i], BATCH, &values[i]));
+	duration = std::chrono::steady_clock::now() - start;
+	std::cout << name << ", ReadMany: " << MillionOpsPerSecond(LOOKUPS, duration) << " Mops/s (found " << found
+	          << ")" << std::endl;
+
+	InterleavedLookup<Map> lookup(map);
+	found = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < LOOKUPS; i += BATCH)
+		found += uint32_t(lookup.ReadMany(&keys[i], BATCH, &values[i]));
+	duration = std::chrono::steady_clock::now() - start;
+	std::cout << name << ", InterleavedLookup: " << MillionOpsPerSecond(LOOKUPS, duration) << " Mops/s (found "
+	          << found << ")" << std::endl;
+}
+#endif
+
+// Populating a map of 2^22 records with Add one record at a time, and with BulkLoad
+static void BenchmarkBulkLoad()
+{
+	constexpr uint32_t ELEMENTS = 1 << 22;
+
+	std::vector<std::pair<uint32_t, int>> records(ELEMENTS);
+	for (uint32_t i = 0; i < ELEMENTS; ++i)
+		records[i] = {i * 2, int(i)};
+	std::shuffle(records.begin(), records.end(), std::mt19937{1});
+
+	{
+		Hash<uint32_t, int, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ> map(ELEMENTS);
+		uint32_t added = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& record : records)
+			added += map.Add(record.first, record.second);
+		const auto duration = std::chrono::steady_clock::now() - start;
+		std::cout << "Add: " << MillionOpsPerSecond(ELEMENTS, duration) << " Mops/s (added " << added << ")"
+		          << std::endl;
+	}
+
+	for (const uint32_t threads : {1U, 2U, 4U, std::thread::hardware_concurrency()})
+	{
+		Hash<uint32_t, int, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ> map(ELEMENTS);
+		const auto start = std::chrono::steady_clock::now();
+		const size_t added = map.BulkLoad(records.begin(), records.end(), threads);
+		const auto duration = std::chrono::steady_clock::now() - start;
+		std::cout << "BulkLoad, " << threads << " threads: " << MillionOpsPerSecond(ELEMENTS, duration)
+		          << " Mops/s (added " << added << ")" << std::endl;
+	}
+}
+
+void RunBenchmarks()
+{
+	BenchmarkHashDistribution();
+	BenchmarkHasher<DefaultHasher<int>>("DefaultHasher");
+	BenchmarkHasher<MultiplicativeHasher<int>>("MultiplicativeHasher");
+	BenchmarkHasher<SipHasher<int>>("SipHasher");
+	BenchmarkLargeTable<DefaultHasher<uint64_t>>("32-bit hash");
+	BenchmarkLargeTable<DefaultHasher<uint64_t, uint64_t>>("64-bit hash");
+	BenchmarkAddTakeOccupancy();
+	BenchmarkAddTakeScaling<HeapAllocator<32>>("Add+Take, shared free-list");
+	BenchmarkAddTakeScaling<HeapAllocator<32, 32>>("Add+Take, magazines of 32");
+	BenchmarkGrowFromHeap();
+	BenchmarkBulkLoad();
+	BenchmarkLookupLatency<8>();
+	BenchmarkReadMany();
+	BenchmarkReceiver();
+	BenchmarkTakeAny();
+#ifdef HASH_COROUTINES
+	{
+		Hash<uint32_t, int, HeapAllocator<8>, MapMode::PARALLEL_INSERT_READ> map(1 << 21);
+		BenchmarkInterleaved("Fixed buckets", map, 1 << 21);
+	}
+	{
+		// Chains of 4 nodes on average
+		Hash<uint32_t, int, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ_GROW_FROM_HEAP> map(1 << 18);
+		BenchmarkInterleaved("Linked buckets", map, 1 << 21);
+	}
+#endif
+	BenchmarkLookupLatency<16>();
+	BenchmarkLookupLatency<32>();
+	BenchmarkLookupLatency<64>();
+	BenchmarkPlacement<2, BucketPlacement::SINGLE>("Single placement");
+	BenchmarkPlacement<2, BucketPlacement::TWO_CHOICE>("Two-choice placement");
+	BenchmarkPlacement<4, BucketPlacement::SINGLE>("Single placement");
+	BenchmarkPlacement<4, BucketPlacement::TWO_CHOICE>("Two-choice placement");
+	BenchmarkGrowable<Hash<int, int, HeapAllocator<32>>>("Presized for 2^20 items", 1 << 20);
+	BenchmarkGrowable<GrowableHash<int, int, HeapAllocator<32>>>("Growable from 2^10 items", 1 << 10);
+}
+
+// Adds and takes keys in a loop, so only a few items are in the map at a time, optionally with threads taking
+// arbitrary items meanwhile. Add must not fail, while taken nodes wait for pinned operations to end.
+static bool ValidateTakeChurn(const uint32_t elements, const uint32_t adders, const uint32_t takeAnyThreads)
+{
+	constexpr uint32_t ROUNDS = 1 << 14;
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> map(elements);
+	std::atomic<uint32_t> failedAdds{0};
+	std::atomic<uint32_t> running{adders};
+	RunInParallel(adders + takeAnyThreads, [&](const uint32_t thread) {
+		uint32_t k = 0;
+		uint32_t v = 0;
+		if (thread < adders)
+		{
+			for (uint32_t i = 0; i < ROUNDS; ++i)
+			{
+				k = thread * ROUNDS + i;
+				if (!map.Add(k, i))
+					++failedAdds;
+				map.Take(k, v);
+			}
+			--running;
+		}
+		else
+		{
+			while (running)
+				map.TakeAny(k, v);
+		}
+	});
+
+	std::cout << "Take churn, " << elements << " nodes, " << adders << " adders, " << takeAnyThreads
+	          << " TakeAny threads: " << failedAdds << " failed adds" << std::endl;
+	return failedAdds == 0;
+}
+
+// Prints the outcome of a functional check, returns \p ok
+static bool Report(const char* name, const bool ok)
+{
+	std::cout << name << ": " << (ok ? "ok" : "FAILED") << std::endl;
+	return ok;
+}
+
+// TakeWait wakes up once the key is added, and gives up after the timeout if it never is
+static bool ValidateTakeWait()
+{
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> map(1 << 10);
+	uint32_t v = 0;
+	auto waiter = std::async(std::launch::async, [&]() { return map.TakeWait(1, v); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	map.Add(2, 2); // Adds of other keys wake the waiter, which must keep waiting
+	map.Add(1, 42);
+	const bool woken = waiter.wait_for(std::chrono::seconds(10)) == std::future_status::ready && waiter.get();
+
+	uint32_t missing = 0;
+	const auto start = std::chrono::steady_clock::now();
+	const bool timedOut = !map.TakeWait(3, missing, std::chrono::milliseconds(10));
+	const bool waited = std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(10);
+
+	// A waiter with a timeout is woken by the add, not by its next poll
+	uint32_t late = 0;
+	auto timedWaiter = std::async(std::launch::async, [&]() {
+		const bool taken = map.TakeWait(4, late, std::chrono::seconds(10));
+		return std::make_pair(taken, std::chrono::steady_clock::now());
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	const auto added = std::chrono::steady_clock::now();
+	map.Add(4, 7);
+	const bool timedReady = timedWaiter.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+	const auto timedResult = timedReady ? timedWaiter.get() : std::make_pair(false, added);
+	const bool prompt = timedResult.first && late == 7 && timedResult.second - added < std::chrono::milliseconds(50);
+	return Report("TakeWait", woken && v == 42 && timedOut && waited && prompt && map.Take(2) == 2);
+}
+
+// Concurrent FetchAdds of the same keys sum up to the total of all threads
+static bool ValidateFetchAdd()
+{
+	constexpr uint32_t THREADS = 8;
+	constexpr uint32_t ROUNDS = 1 << 14;
+	constexpr uint32_t KEYS = 16;
+	Hash<uint32_t, uint64_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ_UPDATE> map(1 << 10);
+	RunInParallel(THREADS, [&](const uint32_t) {
+		for (uint32_t i = 0; i < ROUNDS; ++i)
+			map.FetchAdd(i % KEYS, 1);
+	});
+	bool ok = true;
+	for (uint32_t k = 0; k < KEYS; ++k)
+		ok &= map.Read(k) == uint64_t(THREADS) * ROUNDS / KEYS;
+
+	uint64_t previous = 0;
+	ok &= map.FetchAdd(0, 5, &previous) && previous == uint64_t(THREADS) * ROUNDS / KEYS;
+	return Report("FetchAdd", ok);
+}
+
+// Upsert adds an absent key once and then overwrites it, Update modifies the value in place
+static bool ValidateUpsert()
+{
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ_UPDATE> map(1 << 10);
+	bool ok = map.Upsert(1, 5) && map.Upsert(1, 7) && map.Read(1) == 7;
+	uint32_t values = 0;
+	map.Read(1, [&](const uint32_t) {
+		++values;
+		return true;
+	});
+	ok &= values == 1;
+	ok &= map.Update(1, [](uint32_t& v) { v *= 2; }) && map.Read(1) == 14;
+	ok &= map.Update(2, [](uint32_t& v) { v += 3; }) && map.Read(2) == 3;
+	return Report("Upsert and Update", ok);
+}
+
+struct Words
+{
+	uint32_t a[16];
+};
+
+// Readers never see a value torn by a concurrent Upsert, values of maps without updates are found in place
+static bool ValidateSeqLock()
+{
+	constexpr uint32_t ROUNDS = 1 << 14;
+	Hash<uint32_t, Words, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ_UPDATE> map(1 << 10);
+	map.Upsert(1, Words{});
+	std::atomic<uint32_t> torn{0};
+	RunInParallel(2, [&](const uint32_t thread) {
+		for (uint32_t i = 0; i < ROUNDS; ++i)
+		{
+			if (thread == 0)
+			{
+				Words w;
+				std::fill(std::begin(w.a), std::end(w.a), i);
+				map.Upsert(1, w);
+			}
+			else
+			{
+				const Words w = map.Read(1);
+				if (std::count(std::begin(w.a), std::end(w.a), w.a[0]) != 16)
+					++torn;
+			}
+		}
+	});
+
+	Hash<uint32_t, Words, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ> plain(1 << 10);
+	Words w;
+	std::fill(std::begin(w.a), std::end(w.a), 7U);
+	plain.Add(1, w);
+	const Words* pFound = plain.Find(1);
+	return Report("Seqlocked Upsert", torn == 0 && pFound && pFound->a[15] == 7 && plain.Find(2) == nullptr);
+}
+
+// DrainAll visitors nested over more maps than a thread keeps in its table of epoch records, so the inner maps pin
+// records, which are released again when their guards end
+template <typename Map>
+static uint32_t DrainNested(std::vector<std::unique_ptr<Map>>& maps, const uint32_t i)
+{
+	uint32_t drained = 0;
+	if (i < maps.size())
+		maps[i]->DrainAll([&](const uint32_t&, uint32_t&) { drained += 1 + DrainNested(maps, i + 1); }, 1);
+	return drained;
+}
+
+static bool ValidateNestedDomains()
+{
+	typedef Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> Map;
+	constexpr uint32_t MAPS = 2 * EPOCH_THREAD_DOMAINS;
+	constexpr uint32_t ROUNDS = 64;
+	std::vector<std::unique_ptr<Map>> maps;
+	for (uint32_t i = 0; i < MAPS; ++i)
+		maps.emplace_back(new Map(64));
+
+	uint32_t drained = 0;
+	for (uint32_t round = 0; round < ROUNDS; ++round)
+	{
+		for (auto& map : maps)
+			map->Add(round, round);
+		drained += DrainNested(maps, 0);
+	}
+	return Report("DrainAll nested over many maps", drained == MAPS * ROUNDS);
+}
+
+// TakeAny of several threads takes every item of \p map once
+template <typename Map>
+static bool ValidateTakeAny(const char* name, Map& map, const uint32_t items)
+{
+	constexpr uint32_t THREADS = 4;
+	for (uint32_t k = 0; k < items; ++k)
+		map.Add(k, k);
+
+	std::atomic<uint32_t> taken{0};
+	std::atomic<uint64_t> sum{0};
+	RunInParallel(THREADS, [&](const uint32_t) {
+		uint32_t k = 0;
+		uint32_t v = 0;
+		while (map.TakeAny(k, v))
+		{
+			++taken;
+			sum += (k == v) ? k : 0;
+		}
+	});
+	return Report(name, taken == items && sum == uint64_t(items) * (items - 1) / 2);
+}
+
+// TakeAny with the bucket summary allocated like the buckets, or elided by an external map given no storage for it
+static bool ValidateTakeAnyAllocators()
+{
+	constexpr uint32_t ITEMS = 1 << 8;
+	bool ok = true;
+	{
+		Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> map(ITEMS);
+		ok &= ValidateTakeAny("TakeAny, heap", map, ITEMS);
+	}
+	{
+		Hash<uint32_t, uint32_t, StaticAllocator<ITEMS>, MapMode::PARALLEL_INSERT_TAKE> map;
+		ok &= ValidateTakeAny("TakeAny, static", map, ITEMS);
+	}
+	typedef Hash<uint32_t, uint32_t, ExternalAllocator<>, MapMode::PARALLEL_INSERT_TAKE> ExtHash;
+	std::vector<ExtHash::Bucket> buckets(ComputeHashKeyCount(ITEMS));
+	std::vector<ExtHash::KeyValue> keys(ITEMS);
+	std::vector<std::atomic<ExtHash::KeyValue*>> recycle(ITEMS);
+	std::vector<std::atomic<uint64_t>> summary(ComputeSummaryWordCount(ComputeHashKeyCount(ITEMS)));
+	{
+		ExtHash map;
+		map.Init(ITEMS, buckets.data(), keys.data(), recycle.data(), summary.data());
+		ok &= ValidateTakeAny("TakeAny, external", map, ITEMS);
+	}
+	{
+		ExtHash map;
+		map.Init(ITEMS, buckets.data(), keys.data(), recycle.data());
+		ok &= ValidateTakeAny("TakeAny, external without summary", map, ITEMS);
+	}
+	return ok;
+}
+
+// TakeIf takes only a value satisfying the predicate, and leaves the other values of the key in place
+static bool ValidateTakeIf()
+{
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> map(1 << 10);
+	map.Add(7, 1);
+	map.Add(7, 2);
+	map.Add(7, 3);
+	uint32_t v = 0;
+	const bool rejected = !map.TakeIf(7, [](const uint32_t value) { return value > 3; }, v);
+	const bool accepted = map.TakeIf(7, [](const uint32_t value) { return value == 2; }, v) && v == 2;
+	uint32_t sum = 0;
+	map.Take(7, [&](const uint32_t value) {
+		sum += value;
+		return true;
+	});
+	return Report("TakeIf", rejected && accepted && sum == 1 + 3);
+}
+
+// Takes of a key don't miss its item, while TakeIf concurrently rejects it
+template <typename V, typename M>
+static bool ValidateTakeIfRejects(const char* name, M&& make)
+{
+	constexpr uint32_t KEYS = 1 << 12;
+	constexpr uint32_t TAKERS = 2;
+	Hash<uint32_t, V, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> map(KEYS);
+	for (uint32_t k = 0; k < KEYS; ++k)
+		map.Add(k, make(k));
+
+	std::atomic<uint32_t> rejecting{0};
+	std::atomic<uint32_t> finished{0};
+	std::atomic<uint32_t> missed{0};
+	RunInParallel(2 * TAKERS, [&](const uint32_t thread) {
+		V v{};
+		if (thread < TAKERS)
+		{
+			while (rejecting < TAKERS)
+				std::this_thread::yield();
+			for (uint32_t k = thread; k < KEYS; k += TAKERS)
+				missed += map.Take(k, v) ? 0 : 1;
+			++finished;
+		}
+		else
+		{
+			// Predicate yields, so that the takers run while an item may be reserved, keys are visited downwards to
+			// meet the takers. Sweeps are limited, since a take waits for as long as its item stays reserved.
+			const auto reject = [](const V&) {
+				std::this_thread::yield();
+				return false;
+			};
+			++rejecting;
+			for (uint32_t sweep = 0; sweep < 4 && finished < TAKERS; ++sweep)
+				for (uint32_t k = KEYS; k-- > 0;)
+					map.TakeIf(k, reject, v);
+		}
+	});
+	return Report(name, missed == 0);
+}
+
+// Erases and adds keys in a loop far beyond the capacity of the map, Add fails if erased nodes are not recycled
+static bool ValidateEraseRefill()
+{
+	constexpr uint32_t ELEMENTS = 1 << 10;
+	constexpr uint32_t THREADS = 4;
+	constexpr uint32_t ROUNDS = 64;
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ_ERASE> map(ELEMENTS);
+	std::atomic<uint32_t> failures{0};
+	RunInParallel(THREADS, [&](const uint32_t thread) {
+		const uint32_t first = thread * (ELEMENTS / THREADS);
+		for (uint32_t round = 0; round < ROUNDS; ++round)
+		{
+			for (uint32_t k = first; k < first + ELEMENTS / THREADS; ++k)
+			{
+				if (!map.Add(k, round))
+					++failures;
+			}
+			for (uint32_t k = first; k < first + ELEMENTS / THREADS; ++k)
+			{
+				uint32_t v = 0;
+				if (!map.Read(k, v) || v != round || map.Erase(k) != 1 || map.Read(k, v))
+					++failures;
+			}
+		}
+	});
+	map.Reclaim();
+	uint32_t count = 0;
+	map.ForEach([&](const uint32_t&, const uint32_t&) { ++count; });
+	return Report("Erase and refill", failures == 0 && count == 0);
+}
+
+// Find returns the value in its node, Extract keeps the value in its node until the handle is released
+static bool ValidateFindExtract()
+{
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ> readMap(1 << 10);
+	readMap.Add(1, 10);
+	const uint32_t* pValue = readMap.Find(1);
+	bool ok = pValue && *pValue == 10 && readMap.Find(2) == nullptr;
+
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> takeMap(1 << 10);
+	takeMap.Add(5, 5);
+	{
+		auto node = takeMap.Extract(5);
+		uint32_t v = 0;
+		ok &= node && *node == 5 && !takeMap.Take(5, v) && !takeMap.Extract(6);
+	}
+	takeMap.Add(5, 6);
+	return Report("Find and Extract", ok && takeMap.Take(5) == 6);
+}
+
+// Values are constructed in the node by Emplace, and moved in to it by Add(K&&, V&&)
+static bool ValidateEmplace()
+{
+	Hash<std::string, std::pair<uint32_t, std::string>, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ> map(1 << 10);
+	bool ok = map.Emplace(std::string("a"), 1U, "one") && map.Emplace("b", 2U, "two");
+	std::string key("c");
+	std::pair<uint32_t, std::string> value(3U, "three");
+	ok &= map.Add(std::move(key), std::move(value));
+
+	const std::pair<uint32_t, std::string>* pA = map.Find("a");
+	const std::pair<uint32_t, std::string>* pC = map.Find("c");
+	ok &= pA && pA->first == 1 && pA->second == "one";
+	ok &= pC && pC->first == 3 && pC->second == "three";
+	ok &= map.Read("b").second == "two" && map.Find("d") == nullptr;
+	return Report("Emplace and Add(K&&, V&&)", ok);
+}
+
+// ForEach and ParallelForEach visit each item exactly once, DrainAll takes each item exactly once
+static bool ValidateForEach()
+{
+	constexpr uint32_t ITEMS = 1 << 14;
+	constexpr uint32_t THREADS = 4;
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ> map(ITEMS);
+	for (uint32_t k = 0; k < ITEMS; ++k)
+		map.Add(k, k * 2);
+
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	map.ForEach([&](const uint32_t& k, const uint32_t& v) {
+		++count;
+		sum += (v == k * 2) ? k : 0;
+	});
+	bool ok = count == ITEMS && sum == uint64_t(ITEMS) * (ITEMS - 1) / 2;
+
+	std::atomic<uint64_t> parallelCount{0};
+	std::atomic<uint64_t> parallelSum{0};
+	map.ParallelForEach(
+	    [&](const uint32_t& k, const uint32_t& v) {
+		    ++parallelCount;
+		    parallelSum += (v == k * 2) ? k : 0;
+	    },
+	    THREADS);
+	ok &= parallelCount == ITEMS && parallelSum == uint64_t(ITEMS) * (ITEMS - 1) / 2;
+
+	Hash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_TAKE> takeMap(ITEMS);
+	for (uint32_t k = 0; k < ITEMS; ++k)
+		takeMap.Add(k, k * 2);
+	std::atomic<uint64_t> drainedSum{0};
+	const size_t drained = takeMap.DrainAll(
+	    [&](const uint32_t& k, uint32_t& v) { drainedSum += (v == k * 2) ? k : 0; }, THREADS);
+	uint32_t k = 0;
+	uint32_t v = 0;
+	ok &= drained == ITEMS && drainedSum == uint64_t(ITEMS) * (ITEMS - 1) / 2 && !takeMap.TakeAny(k, v);
+	return Report("ForEach, ParallelForEach and DrainAll", ok);
+}
+
+// GrowableHash grows from a small capacity under concurrent adds and reads, and keeps every item readable
+static bool ValidateGrowable()
+{
+	constexpr uint32_t ITEMS = 1 << 16;
+	constexpr uint32_t THREADS = 4;
+	GrowableHash<uint32_t, uint32_t, HeapAllocator<>, MapMode::PARALLEL_INSERT_READ> map(1 << 6);
+	std::atomic<uint32_t> failures{0};
+	RunInParallel(THREADS, [&](const uint32_t thread) {
+		for (uint32_t k = thread; k < ITEMS; k += THREADS)
+		{
+			uint32_t v = 0;
+			if (!map.Add(k, k) || !map.Read(k, v) || v != k)
+				++failures;
+		}
+	});
+	uint64_t count = 0;
+	map.ForEach([&](const uint32_t&, const uint32_t&) { ++count; });
+	for (uint32_t k = 0; k < ITEMS; ++k)
+	{
+		if (map.Read(k) != k)
+			++failures;
+	}
+	return Report("GrowableHash", failures == 0 && count == ITEMS && map.GetLiveGenerations() <= 2);
+}
+
+bool RunFunctionalTests()
+{
+	bool ok = true;
+	ok &= ValidateTakeChurn(1 << 12, 8, 0);
+	ok &= ValidateTakeChurn(1 << 12, 16, 0);
+	ok &= ValidateTakeChurn(1 << 12, 8, 4);
+	ok &= ValidateTakeChurn(1 << 16, 8, 4);
+	ok &= ValidateTakeWait();
+	ok &= ValidateFetchAdd();
+	ok &= ValidateUpsert();
+	ok &= ValidateSeqLock();
+	ok &= ValidateEraseRefill();
+	ok &= ValidateTakeIf();
+	ok &= ValidateTakeAnyAllocators();
+	ok &= ValidateNestedDomains();
+	ok &= ValidateTakeIfRejects<uint32_t>("Take while TakeIf rejects, copied values",
+	                                      [](const uint32_t k) { return k; });
+	ok &= ValidateTakeIfRejects<std::string>("Take while TakeIf rejects, reserved values",
+	                                         [](const uint32_t k) { return std::to_string(k); });
+	ok &= ValidateFindExtract();
+	ok &= ValidateEmplace();
+	ok &= ValidateForEach();
+	ok &= ValidateGrowable();
+	return ok;
+}
+
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu
 // Debug program: F5 or Debug > Start Debugging menu
 
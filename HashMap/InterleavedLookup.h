@@ -0,0 +1,241 @@
+#pragma once
+#include "Hash.h"
+
+// Interleaved lookups need C++20 coroutines, the header is empty without them
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define HASH_COROUTINES 1
+#endif
+#endif
+
+#ifdef HASH_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <new>
+
+//! \brief Looks up batches of keys as coroutines, which suspend after each prefetch
+//! \details Each lookup prefetches its bucket and suspends, then prefetches the candidate nodes (or the next node
+//!			 of the chain in PARALLEL_INSERT_READ_GROW_FROM_HEAP mode) and suspends again, while the scheduler
+//!			 resumes the other IN_FLIGHT - 1 lookups in round-robin. Unlike the fixed stages of Hash::ReadMany,
+//!			 lookups of different lengths overlap their cache misses, e.g. long chains of linked buckets.
+//!
+//!			 A single object is used by one thread at a time, the map itself can be used concurrently.
+//!			 Coroutine frames are allocated once per batch. If they cannot be allocated, the batch falls back to
+//!			 Hash::ReadMany or Hash::TakeMany.
+//! \tparam IN_FLIGHT	Number of lookups interleaved
+template <typename _Hash, uint32_t IN_FLIGHT = INTERLEAVED_LOOKUPS>
+class InterleavedLookup
+{
+	typedef typename _Hash::KeyType K;
+	typedef typename _Hash::ValueType V;
+	typedef typename _Hash::HashType HashType;
+	typedef typename _Hash::Bucket Bucket;
+	typedef typename _Hash::KeyValue KeyValue;
+	typedef typename _Hash::BucketProbe BucketProbe;
+	typedef typename _Hash::MODE MODE;
+
+	static_assert(IN_FLIGHT > 0, "At least one lookup must be in flight");
+
+public:
+	inline explicit InterleavedLookup(_Hash& hash) noexcept;
+
+	//! \brief Reads the values of \p n keys, see Hash::ReadMany
+	MODE_NOT_TAKE(MODE)
+	inline size_t ReadMany(const K* keys, const size_t n, V* out, bool* found = nullptr) noexcept;
+
+	//! \brief Takes the values of \p n keys, see Hash::TakeMany
+	MODE_TAKE_ONLY(MODE)
+	inline size_t TakeMany(const K* keys, const size_t n, V* out, bool* found = nullptr) noexcept;
+
+private:
+	struct Batch
+	{
+		const K* keys;
+		size_t n;
+		V* out;
+		bool* found;
+		size_t next;  // Next key to be looked up
+		size_t count; // Keys found
+	};
+
+	struct Lookups
+	{
+		struct promise_type
+		{
+			inline Lookups get_return_object() noexcept
+			{
+				return Lookups{std::coroutine_handle<promise_type>::from_promise(*this)};
+			}
+			// Makes the frame allocation non-throwing
+			inline static Lookups get_return_object_on_allocation_failure() noexcept
+			{
+				return Lookups{nullptr};
+			}
+			inline std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+			inline std::suspend_always final_suspend() noexcept
+			{
+				return {};
+			}
+			inline void return_void() noexcept
+			{
+			}
+			inline void unhandled_exception() noexcept
+			{
+				std::terminate();
+			}
+		};
+
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	//! \brief Coroutine looking up keys of \p batch one after another, until the batch is exhausted
+	inline Lookups Lookup(Batch& batch) noexcept;
+
+	//! \brief Runs up to IN_FLIGHT Lookup coroutines over \p batch in round-robin
+	//! \return false if no coroutine could be allocated, i.e. the batch was not processed
+	inline bool Schedule(Batch& batch) noexcept;
+
+private:
+	_Hash& m_hash;
+
+	DISABLE_COPY_MOVE(InterleavedLookup)
+};
+
+/// ******************************************************************************************* ///
+///                                                                                             ///
+///                                        Implementation                                       ///
+///                                                                                             ///
+/// ******************************************************************************************* ///
+
+template <typename _Hash, uint32_t IN_FLIGHT>
+InterleavedLookup<_Hash, IN_FLIGHT>::InterleavedLookup(_Hash& hash) noexcept
+    : m_hash(hash)
+{
+}
+
+template <typename _Hash, uint32_t IN_FLIGHT>
+MODE_NOT_TAKE_IMPL size_t InterleavedLookup<_Hash, IN_FLIGHT>::ReadMany(const K* keys,
+                                                                        const size_t n,
+                                                                        V* out,
+                                                                        bool* found) noexcept
+{
+	Batch batch{keys, n, out, found, 0, 0};
+	// All lookups of the batch run on this thread, so they share a single pin of the map
+	const auto pin = m_hash.Pin();
+	if (!Schedule(batch))
+		return m_hash.ReadMany(keys, n, out, found);
+	return batch.count;
+}
+
+template <typename _Hash, uint32_t IN_FLIGHT>
+MODE_TAKE_ONLY_IMPL size_t InterleavedLookup<_Hash, IN_FLIGHT>::TakeMany(const K* keys,
+                                                                         const size_t n,
+                                                                         V* out,
+                                                                         bool* found) noexcept
+{
+	Batch batch{keys, n, out, found, 0, 0};
+	// All lookups of the batch run on this thread, so they share a single pin of the map
+	const auto pin = m_hash.Pin();
+	if (!Schedule(batch))
+		return m_hash.TakeMany(keys, n, out, found);
+	return batch.count;
+}
+
+template <typename _Hash, uint32_t IN_FLIGHT>
+typename InterleavedLookup<_Hash, IN_FLIGHT>::Lookups InterleavedLookup<_Hash, IN_FLIGHT>::Lookup(
+    Batch& batch) noexcept
+{
+	for (size_t i = batch.next++; i < batch.n; i = batch.next++)
+	{
+		const K& k = batch.keys[i];
+		const HashType h = m_hash.GetKeyHash(k);
+
+		// Probe sequence is the one of Hash::ForEachCandidateBucket, each bucket is prefetched before it's visited
+		bool hit = false;
+		BucketProbe probe(m_hash, h);
+		for (Bucket* pBucket = probe.Next(); pBucket; pBucket = hit ? nullptr : probe.Next())
+		{
+			pBucket->Prefetch();
+			co_await std::suspend_always{};
+
+			if constexpr (std::is_same<MODE, MODE_INSERT_READ_HEAP_BUCKET>::value)
+			{
+				// Each node of the chain is a dependent miss
+				for (KeyValue* pKeyValue = pBucket->GetFirst(); pKeyValue; pKeyValue = pKeyValue->pNext)
+				{
+					Prefetch(pKeyValue);
+					co_await std::suspend_always{};
+					if (pKeyValue->k.hash == h && pKeyValue->k.key == k)
+					{
+						pKeyValue->LoadValue(batch.out[i]);
+						hit = true;
+						break;
+					}
+				}
+			}
+			else
+			{
+				pBucket->PrefetchCandidates(h);
+				co_await std::suspend_always{};
+				if constexpr (std::is_same<MODE, MODE_INSERT_TAKE>::value)
+				{
+					KeyValue* pKeyValue = nullptr;
+					if (pBucket->TakeValue(k, h, &pKeyValue))
+					{
+						batch.out[i] = std::move(pKeyValue->v);
+						m_hash.ReleaseNode(pKeyValue);
+						probe.Taken();
+						hit = true;
+					}
+				}
+				else
+				{
+					hit = pBucket->ReadValue(h, k, batch.out[i]);
+				}
+			}
+		}
+
+		batch.count += hit;
+		if (batch.found)
+			batch.found[i] = hit;
+	}
+}
+
+template <typename _Hash, uint32_t IN_FLIGHT>
+bool InterleavedLookup<_Hash, IN_FLIGHT>::Schedule(Batch& batch) noexcept
+{
+	std::coroutine_handle<typename Lookups::promise_type> lookups[IN_FLIGHT];
+	uint32_t active = 0;
+	while (active < IN_FLIGHT && active < batch.n)
+	{
+		lookups[active] = Lookup(batch).handle;
+		if (!lookups[active])
+			break;
+		++active;
+	}
+	if (active == 0)
+		return batch.n == 0;
+
+	while (active > 0)
+	{
+		for (uint32_t i = 0; i < active;)
+		{
+			lookups[i].resume();
+			if (lookups[i].done())
+			{
+				lookups[i].destroy();
+				lookups[i] = lookups[--active];
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+	return true;
+}
+
+#endif // HASH_COROUTINES
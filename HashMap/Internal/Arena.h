@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include <utility>
+#include "HashDefines.h"
+#include "UtilityFunctions.h"
+
+//! \brief Lock-free arena, which hands out storage for items of type T from heap allocated chunks
+//! \details Each thread is mapped to one of ARENA_SLOTS slots, which holds the chunk the thread is currently
+//!			 bump-allocating from. Items of a chunk are claimed with a single fetch_add, and exhausted chunks are
+//!			 replaced with a new one by CAS, so the global allocator is called once per CHUNK_SIZE items.
+//!			 Items are never returned to the arena individually: all items are destroyed and all chunks freed
+//!			 when the arena is destroyed.
+template <typename T, uint32_t CHUNK_SIZE = ARENA_CHUNK_SIZE>
+class ChunkArena
+{
+	static_assert(CHUNK_SIZE > 0, "Chunk size cannot be zero");
+
+	struct Chunk
+	{
+		inline T* Item(const uint32_t index) noexcept
+		{
+			return reinterpret_cast<T*>(&storage[index * sizeof(T)]);
+		}
+
+		std::atomic<uint32_t> used;
+		Chunk* pNext; // Next chunk in the list of all chunks
+		alignas(T) unsigned char storage[CHUNK_SIZE * sizeof(T)];
+	};
+
+	struct alignas(CACHE_LINE_SIZE) Slot
+	{
+		std::atomic<Chunk*> pCurrent;
+	};
+
+public:
+	inline ChunkArena() noexcept
+	    : m_pChunks(nullptr)
+	{
+		for (uint32_t i = 0; i < ARENA_SLOTS; ++i)
+		{
+			m_slots[i].pCurrent = nullptr;
+		}
+	}
+
+	inline ~ChunkArena() noexcept
+	{
+		Chunk* pChunk = m_pChunks;
+		while (pChunk)
+		{
+			Chunk* pNext = pChunk->pNext;
+			const uint32_t used = pChunk->used < CHUNK_SIZE ? pChunk->used.load() : CHUNK_SIZE;
+			for (uint32_t i = 0; i < used; ++i)
+			{
+				pChunk->Item(i)->~T();
+			}
+			delete pChunk;
+			pChunk = pNext;
+		}
+	}
+
+	//! \brief Allocates an item and constructs it from \p args
+	//! \return Constructed item, or nullptr if a new chunk could not be allocated (\p args are left untouched)
+	template <typename... Args>
+	inline T* Allocate(Args&&... args) noexcept
+	{
+		if (void* pStorage = AllocateStorage())
+			return new (pStorage) T(std::forward<Args>(args)...);
+		return nullptr;
+	}
+
+private:
+	inline void* AllocateStorage() noexcept
+	{
+		std::atomic<Chunk*>& current = m_slots[GetThreadSlot() % ARENA_SLOTS].pCurrent;
+		Chunk* pChunk = current.load(std::memory_order_acquire);
+		for (;;)
+		{
+			if (pChunk)
+			{
+				const uint32_t index = pChunk->used.fetch_add(1, std::memory_order_relaxed);
+				if (index < CHUNK_SIZE)
+					return pChunk->Item(index);
+			}
+
+			// Chunk is exhausted (or the slot is still empty), try to install a new one
+			Chunk* pNew = new (std::nothrow) Chunk;
+			if (pNew == nullptr)
+				return nullptr;
+			pNew->used.store(1, std::memory_order_relaxed);
+
+			if (current.compare_exchange_strong(pChunk, pNew))
+			{
+				LinkChunk(pNew);
+				return pNew->Item(0);
+			}
+			// Another thread sharing the slot installed a chunk first, use that one
+			delete pNew;
+		}
+	}
+
+	inline void LinkChunk(Chunk* pChunk) noexcept
+	{
+		Chunk* pHead = m_pChunks.load(std::memory_order_relaxed);
+		do
+		{
+			pChunk->pNext = pHead;
+		} while (!m_pChunks.compare_exchange_weak(pHead, pChunk));
+	}
+
+private:
+	Slot m_slots[ARENA_SLOTS];
+	std::atomic<Chunk*> m_pChunks; // All chunks allocated by the arena
+
+	DISABLE_COPY_MOVE(ChunkArena)
+};
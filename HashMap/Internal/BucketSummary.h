@@ -0,0 +1,223 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "Container.h"
+#include "HashDefines.h"
+#include "UtilityFunctions.h"
+
+//! \brief Returns the number of words of the BucketSummary of \p count buckets
+constexpr static uint32_t ComputeSummaryWordCount(const uint32_t count) noexcept
+{
+	uint32_t words = 0;
+	for (uint32_t size = count, levels = 0; levels == 0 || size > 1; ++levels)
+	{
+		size = (size + 63) / 64;
+		words += size;
+	}
+	return words;
+}
+
+//! \brief Hierarchical bitmap of the buckets, which may hold items, used to find any item in a sparse map
+//! \details Level 0 has a bit per bucket, every higher level a bit per word of the level below, up to a single root
+//!			 word, so a non-empty bucket is found in O(log64(buckets)) word reads. Bits are hints: a set bit means
+//!			 "may hold items". Adders set the bit after publishing the item, and only when it is not set already.
+//!			 A searcher, which finds a bucket empty (or a word zero), clears its bit and checks it again, restoring
+//!			 the bit if an item arrived meanwhile; together this guarantees, that a published item always remains
+//!			 reachable.
+//!
+//!			 The bitmap is allocated like the buckets of the map (see Container). Maps with an ExternalAllocator
+//!			 may pass no storage to Init, searches fall back to scanning all buckets then.
+//! \tparam KEY_COUNT	Number of buckets of maps with a StaticAllocator
+template <bool ENABLED, AllocatorType TYPE, uint32_t KEY_COUNT = 0>
+class BucketSummary
+{
+	constexpr static const uint32_t MAX_LEVELS = 6; // 64^6 > 2^32 buckets
+
+	typedef std::integral_constant<AllocatorType, TYPE> ALLOCATION_TYPE;
+	typedef Container<std::atomic<uint64_t>, TYPE, ComputeSummaryWordCount(KEY_COUNT)> Bits;
+
+public:
+	//! \brief Allocates the bitmap for \p count buckets, all marked empty
+	HEAP_ONLY(ALLOCATION_TYPE)
+	inline explicit BucketSummary(const uint32_t count) noexcept
+	    : m_bits(ComputeSummaryWordCount(count))
+	{
+		Layout(count);
+	}
+
+	STATIC_ONLY(ALLOCATION_TYPE)
+	inline BucketSummary() noexcept
+	    : m_bits()
+	{
+		Layout(KEY_COUNT);
+		for (uint32_t i = 0; i < ComputeSummaryWordCount(KEY_COUNT); ++i)
+			m_bits[i].store(0, std::memory_order_relaxed);
+	}
+
+	//! \brief Bitmap is elided until Init
+	EXT_ONLY(ALLOCATION_TYPE)
+	inline BucketSummary() noexcept
+	    : m_bits()
+	    , m_count(0)
+	    , m_levels(0)
+	{
+	}
+
+	//! \brief Uses \p bits of ComputeSummaryWordCount(\p count) words as the bitmap of \p count buckets
+	//! \details Without \p bits the bitmap is elided.
+	EXT_ONLY(ALLOCATION_TYPE)
+	inline void Init(std::atomic<uint64_t>* bits, const uint32_t count) noexcept
+	{
+		m_count = count;
+		m_levels = 0;
+		if (bits)
+		{
+			m_bits.Init(bits, ComputeSummaryWordCount(count));
+			Layout(count);
+		}
+	}
+
+	//! \brief Marks bucket \p index as holding items, called after an item was published in it
+	inline void MarkNonEmpty(const uint32_t index) noexcept
+	{
+		if (HasBits())
+			Mark(0, index);
+	}
+
+	//! \brief Calls \p take(index) for non-empty buckets, starting near bucket \p start, until it returns true
+	//! \param[in] isEmpty	Returns true if bucket \p index holds no items, its bit is cleared then
+	//! \return true if \p take returned true
+	template <typename T, typename E>
+	inline bool FindAny(const uint32_t start, T&& take, E&& isEmpty) noexcept
+	{
+		if (!HasBits())
+		{
+			for (uint32_t i = 0; i < m_count; ++i)
+			{
+				const uint32_t index = (start + i) % m_count;
+				if (!isEmpty(index) && take(index))
+					return true;
+			}
+			return false;
+		}
+		return Find(m_levels - 1, 0, start % m_count, take, isEmpty);
+	}
+
+private:
+	//! \brief Computes the levels of the bitmap of \p count buckets
+	inline void Layout(const uint32_t count) noexcept
+	{
+		m_count = count;
+		m_levels = 0;
+
+		uint32_t words = 0;
+		for (uint32_t size = count; m_levels == 0 || size > 1; ++m_levels)
+		{
+			size = (size + 63) / 64;
+			m_offsets[m_levels] = words;
+			words += size;
+		}
+	}
+
+	//! \brief Returns false, if the bitmap was elided, which only maps with an ExternalAllocator do
+	inline bool HasBits() const noexcept
+	{
+		if constexpr (TYPE == AllocatorType::EXTERNAL)
+			return m_levels != 0;
+		return true;
+	}
+
+	inline std::atomic<uint64_t>& Word(const uint32_t level, const uint32_t index) noexcept
+	{
+		return m_bits[m_offsets[level] + index / 64];
+	}
+
+	inline static uint64_t Bit(const uint32_t index) noexcept
+	{
+		return uint64_t(1) << (index % 64);
+	}
+
+	inline void Mark(uint32_t level, uint32_t index) noexcept
+	{
+		for (; level < m_levels; ++level, index /= 64)
+		{
+			// Reading first keeps adders to buckets already marked free of shared writes
+			std::atomic<uint64_t>& word = Word(level, index);
+			if (word.load() & Bit(index))
+				return;
+			if (word.fetch_or(Bit(index)) != 0)
+				return; // Word was non-empty, so its bit in the level above is set
+		}
+	}
+
+	//! \brief Clears the bit of \p index on \p level, then restores it, if \p isEmpty() no longer holds
+	template <typename E>
+	inline void Clear(const uint32_t level, const uint32_t index, E&& isEmpty) noexcept
+	{
+		Word(level, index).fetch_and(~Bit(index));
+		if (!isEmpty())
+			Mark(level, index);
+	}
+
+	//! \brief Searches the children of word \p index of \p level, first the child on the path to \p start
+	template <typename T, typename E>
+	inline bool Find(const uint32_t level, const uint32_t index, const uint32_t start, T& take, E& isEmpty) noexcept
+	{
+		const uint32_t first = index * 64;
+		const uint32_t rotation = (start >> (6 * level)) % 64;
+		uint64_t bits = m_bits[m_offsets[level] + index].load();
+		bits = rotation ? ((bits >> rotation) | (bits << (64 - rotation))) : bits;
+		for (; bits != 0; bits &= (bits - 1))
+		{
+			const uint32_t child = first + ((CountTrailingZeros(bits) + rotation) % 64);
+			if (level == 0)
+			{
+				if (take(child))
+					return true;
+				if (isEmpty(child))
+					Clear(0, child, [&]() { return isEmpty(child); });
+			}
+			else
+			{
+				if (Find(level - 1, child, start, take, isEmpty))
+					return true;
+				std::atomic<uint64_t>& word = m_bits[m_offsets[level - 1] + child];
+				if (word.load() == 0)
+					Clear(level, child, [&]() { return word.load() == 0; });
+			}
+		}
+		return false;
+	}
+
+private:
+	Bits m_bits;
+	uint32_t m_offsets[MAX_LEVELS]; // Index of the first word of each level
+	uint32_t m_count;				// Number of buckets
+	uint32_t m_levels;				// Zero while the bitmap is elided
+
+	DISABLE_COPY_MOVE(BucketSummary)
+};
+
+//! \brief Summary disabled, for maps whose items are never taken
+template <AllocatorType TYPE, uint32_t KEY_COUNT>
+class BucketSummary<false, TYPE, KEY_COUNT>
+{
+public:
+	inline BucketSummary() noexcept
+	{
+	}
+
+	inline explicit BucketSummary(const uint32_t) noexcept
+	{
+	}
+
+	inline void Init(std::atomic<uint64_t>*, const uint32_t) noexcept
+	{
+	}
+
+	inline void MarkNonEmpty(const uint32_t) noexcept
+	{
+	}
+
+	DISABLE_COPY_MOVE(BucketSummary)
+};
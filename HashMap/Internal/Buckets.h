@@ -1,30 +1,62 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
 #include <type_traits>
 #include <random>
 #include <mutex>
 #include <assert.h>
+#include <string.h>
+#include <utility>
 #include "Container.h"
 #include "Debug.h"
+#include "Fingerprints.h"
 
-template <typename K>
+template <typename K, typename HashType = uint32_t>
 struct KeyHashPairT
 {
-	uint32_t hash;
+	HashType hash;
 	K key;
+
+	//! \brief Returns a pair of \p h and \p k, whose padding bytes are zero
+	//! \details Atomic compare-exchange compares the padding too (e.g. 32-bit hash with a 64-bit key), so pairs
+	//!			 compared atomically must not carry indeterminate padding.
+	template <typename _K>
+	inline static KeyHashPairT Make(const HashType h, _K&& k) noexcept
+	{
+		KeyHashPairT pair;
+		if constexpr (std::is_trivially_copyable<K>::value)
+			memset(&pair, 0, sizeof(pair));
+		pair.hash = h;
+		pair.key = std::forward<_K>(k);
+		return pair;
+	}
 };
 
 //
 // FIXME: Add support for utilizing CHECK_FOR_ATOMIC_ACCESS
 //
-template <typename K, typename V, bool CHECK_FOR_ATOMIC_ACCESS = true>
+template <typename K, typename V, bool CHECK_FOR_ATOMIC_ACCESS = true, typename HashType = uint32_t>
 struct KeyValueInsertTake
 {
-	typedef KeyHashPairT<K> KeyHashPair;
+	typedef KeyHashPairT<K, HashType> KeyHashPair;
 
 	std::atomic<KeyHashPair> k;
 	V v; // value
 
+	//! \brief Clears the key, if it is \p key of \p h, i.e. takes the node for the calling thread
+	//! \details Compare-exchange compares the padding of the pair too, which copies of the pair do not necessarily
+	//!			 preserve, so the exchange is retried with the current pair as long as only the padding differs.
+	inline bool ClaimKey(const HashType h, const K& key) noexcept
+	{
+		KeyHashPair expected = KeyHashPair::Make(h, key);
+		while (!k.compare_exchange_strong(expected, KeyHashPair()))
+		{
+			if (expected.hash != h || !(expected.key == key))
+				return false;
+		}
+		return true;
+	}
+
 	typedef std::bool_constant<CHECK_FOR_ATOMIC_ACCESS> CHECK_TYPE;
 
 	template <typename TYPE = CHECK_TYPE,
@@ -58,34 +90,164 @@ struct KeyValueInsertTake
 	}
 };
 
-template <typename K, typename V>
+//! \brief Values updated in place with atomic operations, i.e. arithmetic values and pointers of lock-free atomics
+template <typename V>
+struct IsLockFreeAtomic : public std::bool_constant<std::atomic<V>::is_always_lock_free>
+{
+};
+template <typename V>
+constexpr bool IsAtomicValue =
+    std::conjunction<std::disjunction<std::is_arithmetic<V>, std::is_pointer<V>>, IsLockFreeAtomic<V>>::value;
+
+//! \brief Values updated in place under the seqlock of the node, in MapMode::PARALLEL_INSERT_READ_UPDATE maps
+template <typename V>
+constexpr bool IsSeqLockedValue = !IsAtomicValue<V> && std::is_trivially_copyable<V>::value;
+
+//! \brief Seqlock of a node, whose value is copied by readers while a writer may update it in place
+//! \details The version is odd while a writer is updating the value. Readers retry the copy, if the version was odd
+//!			 or changed during the copy, so they never return a torn value.
+struct ValueSeqLock
+{
+	std::atomic<uint32_t> version{0};
+};
+
+//! \brief Values of other types, and values of maps without in-place updates, have no seqlock
+struct NoValueLock
+{
+};
+
+//! \tparam IN_PLACE_UPDATES	Whether the value may be updated in place while it is read, see Hash::Upsert
+template <typename K, typename V, typename HashType = uint32_t, bool IN_PLACE_UPDATES = false>
 struct KeyValueInsertRead
+    : public std::conditional<IN_PLACE_UPDATES && IsSeqLockedValue<V>, ValueSeqLock, NoValueLock>::type
 {
-	typedef KeyHashPairT<K> KeyHashPair;
+	typedef KeyHashPairT<K, HashType> KeyHashPair;
 	KeyHashPair k;
 	V v; // value
 
+	//! \brief Whether the value may be updated in place while it is read
+	constexpr static const bool UPDATABLE = IN_PLACE_UPDATES && (IsAtomicValue<V> || IsSeqLockedValue<V>);
+
+	KeyValueInsertRead() = default;
+
+	//! \brief Constructs the node with key \p key of \p h and a value constructed from \p args
+	template <typename _K, typename... Args>
+	inline explicit KeyValueInsertRead(const HashType h, _K&& key, Args&&... args) noexcept
+	    : k(KeyHashPair::Make(h, std::forward<_K>(key)))
+	    , v(std::forward<Args>(args)...)
+	{
+	}
+
+	//! \brief Copies the value to \p out, never tearing a value being updated in place
+	inline void LoadValue(V& out) noexcept
+	{
+		if constexpr (!UPDATABLE)
+		{
+			out = v;
+		}
+		else if constexpr (IsAtomicValue<V>)
+		{
+			out = AtomicRef(v).load(std::memory_order_acquire);
+		}
+		else
+		{
+			for (;;)
+			{
+				const uint32_t before = this->version.load(std::memory_order_acquire);
+				if ((before & 1) == 0)
+				{
+					memcpy(&out, &v, sizeof(V));
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (this->version.load(std::memory_order_relaxed) == before)
+						return;
+				}
+				CpuRelax();
+			}
+		}
+	}
+
+	//! \brief Calls \p f with the value, or with a copy of it if the value may be updated in place
+	template <typename F>
+	inline bool VisitValue(F&& f) noexcept
+	{
+		if constexpr (UPDATABLE)
+		{
+			V value;
+			LoadValue(value);
+			return f(static_cast<const V&>(value));
+		}
+		else
+		{
+			return f(static_cast<const V&>(v));
+		}
+	}
+
+	//! \brief Calls \p f(V&) to modify the value in place, concurrent updates of the same value are serialized
+	//! \details For atomic values \p f modifies a copy, which is stored with compare-exchange, so \p f may be called
+	//!			 more than once.
+	template <typename F>
+	inline void UpdateValue(F&& f) noexcept
+	{
+		static_assert(UPDATABLE, "Values updated in place must be trivially copyable");
+		if constexpr (IsAtomicValue<V>)
+		{
+			auto&& value = AtomicRef(v);
+			V expected = value.load(std::memory_order_relaxed);
+			V desired;
+			do
+			{
+				desired = expected;
+				f(desired);
+			} while (!value.compare_exchange_weak(expected, desired, std::memory_order_acq_rel));
+		}
+		else
+		{
+			uint32_t version = this->version.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				if ((version & 1) == 0
+				    && this->version.compare_exchange_weak(version, version + 1, std::memory_order_acquire))
+					break;
+				CpuRelax();
+				version = this->version.load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_release);
+			f(v);
+			this->version.store(version + 2, std::memory_order_release);
+		}
+	}
+
 	constexpr static bool IsAlwaysLockFree() noexcept
 	{
 		return false;
 	}
 };
 
-template <typename K, typename V>
-struct KeyValueLinkedList : public KeyValueInsertRead<K, V>
+template <typename K, typename V, typename HashType = uint32_t>
+struct KeyValueLinkedList : public KeyValueInsertRead<K, V, HashType>
 {
 	std::atomic<KeyValueLinkedList*> pNext;
 
+	KeyValueLinkedList() = default;
+
+	//! \brief Constructs the node and its value in one go, see KeyValueInsertRead
+	template <typename _K, typename... Args>
+	inline explicit KeyValueLinkedList(const HashType h, _K&& key, Args&&... args) noexcept
+	    : KeyValueInsertRead<K, V, HashType>(h, std::forward<_K>(key), std::forward<Args>(args)...)
+	    , pNext(nullptr)
+	{
+	}
+
 	constexpr static bool IsAlwaysLockFree() noexcept
 	{
 		return std::atomic<KeyValueLinkedList*>::is_always_lock_free;
 	}
 };
 
-template <typename K, typename V>
+template <typename K, typename V, typename HashType = uint32_t>
 struct BucketLinkedList
 {
-	typedef KeyValueLinkedList<K, V> KeyValue;
+	typedef KeyValueLinkedList<K, V, HashType> KeyValue;
 
 	inline bool Add(KeyValue* pKeyValue) noexcept
 	{
@@ -105,17 +267,86 @@ struct BucketLinkedList
 		return false;
 	}
 
-	inline bool Get(const uint32_t h, const K& k, V& v) noexcept
+	inline bool Get(const HashType h, const K& k, V& v) noexcept
 	{
 		if (KeyValue* keyValue = GetKeyValue(m_pFirst, h, k))
 		{
-			v = keyValue->v;
+			keyValue->LoadValue(v);
+			return true;
+		}
+		return false;
+	}
+
+	inline bool ReadValue(const HashType hash, const K& k, V& v) noexcept
+	{
+		return Get(hash, k, v);
+	}
+
+	inline bool ReadValue(const HashType hash, const K& k, KeyValue** ppKeyValue) noexcept
+	{
+		if (KeyValue* keyValue = GetKeyValue(m_pFirst, hash, k))
+		{
+			(*ppKeyValue) = keyValue;
 			return true;
 		}
 		return false;
 	}
 
-	inline static KeyValue* GetKeyValue(KeyValue* pNext, const uint32_t h, const K& k) noexcept
+	template <typename F>
+	inline bool ReadValues(const HashType hash, const K& k, F&& f) noexcept
+	{
+		for (KeyValue* keyValue = GetKeyValue(m_pFirst, hash, k); keyValue;
+		     keyValue = GetKeyValue(keyValue->pNext, hash, k))
+		{
+			if (!keyValue->VisitValue(f))
+				return true;
+		}
+		return false;
+	}
+
+	//! \brief Calls \p f(key, value) for each item of the list
+	template <typename F>
+	inline void ForEachItem(F&& f) noexcept
+	{
+		for (KeyValue* pKeyValue = m_pFirst; pKeyValue; pKeyValue = pKeyValue->pNext)
+		{
+			pKeyValue->VisitValue([&](const V& v) {
+				f(static_cast<const K&>(pKeyValue->k.key), v);
+				return true;
+			});
+		}
+	}
+
+	//! \brief Linked buckets are never full, so items never overflow to the following buckets
+	constexpr static uint32_t GetOverflow() noexcept
+	{
+		return 0;
+	}
+
+	inline static void RaiseOverflow(const uint32_t) noexcept
+	{
+	}
+
+	//! \brief Returns the first node of the list, nodes are linked with KeyValue::pNext
+	inline KeyValue* GetFirst() const noexcept
+	{
+		return m_pFirst;
+	}
+
+	//! \brief Prefetches the head of the list
+	inline void Prefetch() const noexcept
+	{
+		::Prefetch(&m_pFirst);
+	}
+
+	//! \brief Prefetches the first node of the list, the rest of the chain is dependent on it
+	inline void PrefetchCandidates(const HashType) const noexcept
+	{
+		if (const KeyValue* pFirst = m_pFirst.load(std::memory_order_relaxed))
+			::Prefetch(pFirst);
+	}
+
+	inline static KeyValue* GetKeyValue(KeyValue* pNext, const HashType h, const K& k) noexcept
 	{
 		while (pNext)
 		{
@@ -131,7 +362,7 @@ struct BucketLinkedList
 	class Iterator
 	{
 	public:
-		typedef BucketLinkedList<K, V> Bucket;
+		typedef BucketLinkedList<K, V, HashType> Bucket;
 
 		inline Iterator() noexcept
 		    : _bucket(nullptr)
@@ -140,7 +371,7 @@ struct BucketLinkedList
 		{
 		}
 
-		inline explicit Iterator(Bucket* bucket, const uint32_t h, const K& k) noexcept
+		inline explicit Iterator(Bucket* bucket, const HashType h, const K& k) noexcept
 		    : _bucket(bucket)
 		    , _current(nullptr)
 		    , _h(h)
@@ -177,31 +408,33 @@ struct BucketLinkedList
 	private:
 		Bucket* _bucket;
 		KeyValue* _current;
-		uint32_t _h;
+		HashType _h;
 		K _k;
 	};
 
-	inline ~BucketLinkedList() noexcept
-	{
-		KeyValue* pDelete = m_pFirst;
-		while (pDelete)
-		{
-			KeyValue* next = pDelete->pNext;
-			delete pDelete;
-			pDelete = next;
-		}
-	}
+	//! \brief Iterator type used by HashIterator, read-only iterators release nothing
+	template <typename Releaser>
+	using IteratorOf = Iterator;
 
 private:
+	// Nodes are owned by the arena of the map, which releases them at destruction
 	std::atomic<KeyValue*> m_pFirst;
 };
 
-template <typename K, typename V, uint32_t COLLISION_SIZE>
+//! \brief Returns overflow hint \p current with distance \p distance and the update count bumped
+//! \details The low bits of a hint hold the distance, the bits above count its updates, see
+//!			 BucketInsertTake::LowerOverflow.
+constexpr static uint32_t NextOverflow(const uint32_t current, const uint32_t distance) noexcept
+{
+	return ((current + OVERFLOW_MAX_DISTANCE + 1) & ~OVERFLOW_MAX_DISTANCE) | distance;
+}
+
+template <typename K, typename V, uint32_t COLLISION_SIZE, typename HashType = uint32_t, bool IN_PLACE_UPDATES = false>
 class BucketInsertRead
 {
 public:
-	typedef KeyValueInsertRead<K, V> KeyValue;
-	typedef KeyHashPairT<K> KeyHashPair;
+	typedef KeyValueInsertRead<K, V, HashType, IN_PLACE_UPDATES> KeyValue;
+	typedef KeyHashPairT<K, HashType> KeyHashPair;
 
 	inline bool Add(KeyValue* pKeyValue) noexcept
 	{
@@ -212,10 +445,13 @@ public:
 			//
 			// FIXME: Add return value
 			//
-			// Bucket is full
+			// Bucket is full, only the slots of erased items can be reused
 			--m_usageCounter;
-			return false;
+			return m_erased.load(std::memory_order_relaxed) != 0 && ReuseErasedSlot(pKeyValue);
 		}
+		// Fingerprint is written before the slot is published
+		m_fingerprints.Set(myIndex, GetFingerprint(pKeyValue->k.hash));
+
 		KeyValue* pExpected = nullptr;
 		const bool ret = m_bucket[myIndex].compare_exchange_strong(pExpected, pKeyValue);
 #ifdef _DEBUG
@@ -227,62 +463,163 @@ public:
 		return ret; // On release build, compiler will optimize "ret" away, and directly returns
 	}
 
-	inline bool ReadValue(const uint32_t hash, const K& k, V& v) noexcept
+	inline bool ReadValue(const HashType hash, const K& k, V& v) noexcept
 	{
 		KeyValue* keyval = nullptr;
-		if (ReadValue(k, hash, &keyval))
+		if (ReadValue(hash, k, &keyval))
 		{
-			v = keyval->v;
+			keyval->LoadValue(v);
 			return true;
 		}
 		return false;
 	}
 
-	inline bool ReadValue(const uint32_t hash, const K& k, KeyValue** ppKeyValue) noexcept
+	inline bool ReadValue(const HashType hash, const K& k, KeyValue** ppKeyValue) noexcept
 	{
-		if (m_usageCounter == 0)
-			return false;
+		uint32_t startIndex = 0;
+		return ReadValueFromIndex(startIndex, hash, k, ppKeyValue);
+	}
 
-		for (uint32_t i = 0; i < COLLISION_SIZE; ++i)
+	//! \return true if \p f requested to stop
+	template <typename F>
+	inline bool ReadValues(const HashType hash, const K& k, F&& f) noexcept
+	{
+		for (uint64_t candidates = GetCandidates(hash); candidates != 0; candidates &= (candidates - 1))
 		{
-			KeyValue* pCandidate = m_bucket[i];
-			if (pCandidate == nullptr)
+			KeyValue* pCandidate = m_bucket[CountTrailingZeros(candidates)];
+			if (IsItem(pCandidate) && pCandidate->k.hash == hash && pCandidate->k.key == k)
 			{
-				break; // No more items
+				if (!pCandidate->VisitValue(f))
+					return true;
 			}
-			else if (pCandidate->k.hash == hash && pCandidate->k.key == k)
+		}
+		return false;
+	}
+
+	//! \brief Replaces the items of \p k with tombstones, and passes their nodes to \p retire
+	//! \details A tombstone keeps its slot used, so slots are still filled in order and the usage counter stays
+	//!			 valid, readers skip it. Add reuses the slots of tombstones, once the bucket is full.
+	//! \return Number of items erased
+	template <typename R>
+	inline uint32_t Erase(const HashType hash, const K& k, R&& retire) noexcept
+	{
+		uint32_t erased = 0;
+		for (uint64_t candidates = GetCandidates(hash); candidates != 0; candidates &= (candidates - 1))
+		{
+			std::atomic<KeyValue*>& slot = m_bucket[CountTrailingZeros(candidates)];
+			KeyValue* pCandidate = slot;
+			if (IsItem(pCandidate) && pCandidate->k.hash == hash && pCandidate->k.key == k
+			    && slot.compare_exchange_strong(pCandidate, Tombstone()))
 			{
-				(*ppKeyValue) = pCandidate;
-				return true;
+				m_erased.fetch_add(1, std::memory_order_relaxed);
+				retire(pCandidate);
+				++erased;
 			}
 		}
+		return erased;
+	}
+
+	//! \brief Calls \p f(key, value) for each item of the bucket, slots being added and tombstones are skipped
+	template <typename F>
+	inline void ForEachItem(F&& f) noexcept
+	{
+		ForEachNode([&](KeyValue& keyValue) {
+			keyValue.VisitValue([&](const V& v) {
+				f(static_cast<const K&>(keyValue.k.key), v);
+				return true;
+			});
+		});
+	}
+
+	//! \brief Calls \p f(KeyValue&) with the node of each item of the bucket, see ForEachItem
+	template <typename F>
+	inline void ForEachNode(F&& f) noexcept
+	{
+		const uint32_t used = m_usageCounter;
+		for (uint32_t i = 0; i < used && i < COLLISION_SIZE; ++i)
+		{
+			KeyValue* pKeyValue = m_bucket[i];
+			if (IsItem(pKeyValue))
+				f(*pKeyValue);
+		}
+	}
+
+	//! \brief Returns the number of items in the bucket (including items being added and tombstones)
+	inline uint32_t GetUsage() const noexcept
+	{
+		return m_usageCounter.load(std::memory_order_relaxed);
+	}
+
+	//! \brief Returns the distance of the farthest following bucket, which may hold items overflown from this bucket
+	inline uint32_t GetOverflow() const noexcept
+	{
+		return m_overflow & OVERFLOW_MAX_DISTANCE;
+	}
+
+	//! \brief Returns the overflow hint along with its update count, see LowerOverflow
+	inline uint32_t GetOverflowState() const noexcept
+	{
+		return m_overflow;
+	}
+
+	//! \brief Records that an item of this bucket may be stored \p distance buckets after this one
+	//! \details Every call counts as an update, see BucketInsertTake::RaiseOverflow.
+	inline void RaiseOverflow(const uint32_t distance) noexcept
+	{
+		uint32_t current = m_overflow;
+		while (!m_overflow.compare_exchange_weak(
+		    current, NextOverflow(current, std::max(current & OVERFLOW_MAX_DISTANCE, distance))))
+		{
+		}
+	}
+
+	//! \brief Lowers the overflow hint to \p distance, unless it was updated after \p observed was read
+	inline bool LowerOverflow(uint32_t observed, const uint32_t distance) noexcept
+	{
+		return m_overflow.compare_exchange_strong(observed, NextOverflow(observed, distance));
+	}
+
+	//! \brief Returns true, if the bucket may hold an item, whose hash satisfies \p pred
+	//! \details Slots being filled count as matching, tombstones don't. Caller must pin the map in
+	//!			 MapMode::PARALLEL_INSERT_READ_ERASE, since the nodes in the slots may be erased meanwhile.
+	template <typename P>
+	inline bool MayHold(P&& pred) const noexcept
+	{
+		const uint32_t used = m_usageCounter;
+		for (uint32_t i = 0; i < used && i < COLLISION_SIZE; ++i)
+		{
+			const KeyValue* pCandidate = m_bucket[i];
+			if (pCandidate == nullptr || (IsItem(pCandidate) && pred(pCandidate->k.hash)))
+				return true;
+		}
 		return false;
 	}
 
-	inline void ReadValues(const uint32_t hash, const K& k, const std::function<bool(const V&)>& f) noexcept
+	//! \brief Prefetches the slots of the bucket and the fields, which filter them
+	inline void Prefetch() const noexcept
 	{
-		if (m_usageCounter == 0)
-			return;
+		// Slots of larger buckets span several cache lines
+		for (uint32_t i = 0; i < COLLISION_SIZE; i += CACHE_LINE_SIZE / sizeof(KeyValue*))
+			::Prefetch(&m_bucket[i]);
+		::Prefetch(&m_usageCounter);
+		::Prefetch(&m_fingerprints);
+	}
 
-		for (uint32_t i = 0; i < COLLISION_SIZE; ++i)
+	//! \brief Prefetches the nodes in the slots, whose fingerprint matches \p hash
+	inline void PrefetchCandidates(const HashType hash) const noexcept
+	{
+		for (uint64_t candidates = GetCandidates(hash); candidates != 0; candidates &= (candidates - 1))
 		{
-			KeyValue* pCandidate = m_bucket[i];
-			if (pCandidate == nullptr)
-			{
-				break;
-			}
-			else if (pCandidate->k.hash == hash && pCandidate->k.key == k)
-			{
-				if (!f(pCandidate->v))
-					break;
-			}
+			const KeyValue* pCandidate = m_bucket[CountTrailingZeros(candidates)].load(std::memory_order_relaxed);
+			if (IsItem(pCandidate))
+				::Prefetch(pCandidate);
 		}
 	}
 
 	class Iterator
 	{
 	public:
-		typedef BucketInsertRead<K, V, COLLISION_SIZE> Bucket;
+		typedef BucketInsertRead<K, V, COLLISION_SIZE, HashType> Bucket;
 
 		inline Iterator() noexcept
 		    : _bucket(nullptr)
@@ -292,7 +629,7 @@ public:
 		{
 		}
 
-		inline explicit Iterator(Bucket* bucket, const uint32_t h, const K& k) noexcept
+		inline explicit Iterator(Bucket* bucket, const HashType h, const K& k) noexcept
 		    : _bucket(bucket)
 		    , _current(nullptr)
 		    , _currentIndex(0)
@@ -324,34 +661,72 @@ public:
 		Bucket* _bucket;
 		KeyValue* _current;
 		uint32_t _currentIndex;
-		uint32_t _hash;
+		HashType _hash;
 
 		K _k;
 	};
 
+	//! \brief Iterator type used by HashIterator, read-only iterators release nothing
+	template <typename Releaser>
+	using IteratorOf = Iterator;
+
 private:
-	// Special implementation for Iterator
-	inline bool
-	    ReadValueFromIndex(uint32_t& startIndex, const uint32_t hash, const K& k, KeyValue** ppKeyValue) noexcept
+	//! \brief Marks the slot of an erased item
+	inline static KeyValue* Tombstone() noexcept
 	{
-		if (m_usageCounter == 0)
-		{
-			return false;
-		}
+		return reinterpret_cast<KeyValue*>(uintptr_t(1));
+	}
+
+	//! \brief Returns true if \p pKeyValue is an item, i.e. neither an empty slot nor a tombstone
+	inline static bool IsItem(const KeyValue* pKeyValue) noexcept
+	{
+		return reinterpret_cast<uintptr_t>(pKeyValue) > uintptr_t(1);
+	}
 
+	//! \brief Adds \p pKeyValue to the slot of an erased item
+	//! \details The tombstone is swapped to nullptr to claim the slot, so readers skip the slot until the new
+	//!			 fingerprint is written and the item is published.
+	inline bool ReuseErasedSlot(KeyValue* pKeyValue) noexcept
+	{
 		for (uint32_t i = 0; i < COLLISION_SIZE; ++i)
 		{
-			const uint32_t actualIdx = (i + startIndex) % COLLISION_SIZE;
-
-			KeyValue* pCandidate = m_bucket[actualIdx];
-			if (pCandidate == nullptr)
+			KeyValue* pExpected = Tombstone();
+			if (m_bucket[i].load(std::memory_order_relaxed) == pExpected
+			    && m_bucket[i].compare_exchange_strong(pExpected, nullptr))
 			{
-				break;
+				m_erased.fetch_sub(1, std::memory_order_relaxed);
+				m_fingerprints.Set(i, GetFingerprint(pKeyValue->k.hash));
+				m_bucket[i].store(pKeyValue);
+				return true;
 			}
-			else if (pCandidate->k.hash == hash && pCandidate->k.key == k)
+		}
+		return false;
+	}
+
+	//! \brief Returns bitmask of the used slots, whose fingerprint matches the \p hash
+	inline uint64_t GetCandidates(const HashType hash) const noexcept
+	{
+		const uint32_t used = m_usageCounter;
+		if (used == 0)
+			return 0;
+		return m_fingerprints.Match(GetFingerprint(hash)) & LowBitsMask(used < COLLISION_SIZE ? used : COLLISION_SIZE);
+	}
+
+	// Reads the first matching item starting from \p startIndex, on success \p startIndex is moved past the item
+	inline bool
+	    ReadValueFromIndex(uint32_t& startIndex, const HashType hash, const K& k, KeyValue** ppKeyValue) noexcept
+	{
+		uint64_t candidates = GetCandidates(hash) & ~LowBitsMask(startIndex);
+		for (; candidates != 0; candidates &= (candidates - 1))
+		{
+			const uint32_t index = CountTrailingZeros(candidates);
+
+			// Slot can still be empty, if the item is being added concurrently, or hold a tombstone
+			KeyValue* pCandidate = m_bucket[index];
+			if (IsItem(pCandidate) && pCandidate->k.hash == hash && pCandidate->k.key == k)
 			{
 				(*ppKeyValue) = pCandidate;
-				startIndex = ((actualIdx + 1) % COLLISION_SIZE);
+				startIndex = index + 1;
 				return true;
 			}
 		}
@@ -361,135 +736,284 @@ private:
 private:
 	StaticArray<std::atomic<KeyValue*>, COLLISION_SIZE> m_bucket;
 	std::atomic<uint32_t> m_usageCounter; // Keys in bucket
+	std::atomic<uint32_t> m_overflow; // Distance of the farthest overflown item, its update count in the bits above
+	std::atomic<uint32_t> m_erased;   // Tombstones in bucket
+	BucketFingerprints<COLLISION_SIZE> m_fingerprints;
 };
 
-template <typename K, typename V, uint32_t COLLISION_SIZE>
+template <typename K, typename V, uint32_t COLLISION_SIZE, typename HashType = uint32_t>
 class BucketInsertTake
 {
 public:
-	typedef KeyValueInsertTake<K, V> KeyValue;
-	typedef KeyHashPairT<K> KeyHashPair;
+	typedef KeyValueInsertTake<K, V, true, HashType> KeyValue;
+	typedef KeyHashPairT<K, HashType> KeyHashPair;
 
 	inline bool Add(KeyValue* pKeyValue) noexcept
 	{
-		const auto usage_now = ++m_usageCounter;
-		if (usage_now > COLLISION_SIZE)
+		uint64_t occupancy = m_occupancy.load(std::memory_order_relaxed);
+		for (;;)
 		{
-			//
-			// FIXME: Add return value
-			//
-			// Bucket is full
-			--m_usageCounter;
-			return false;
-		}
+			const uint64_t freeSlots = ~occupancy & SLOT_MASK;
+			if (freeSlots == 0)
+			{
+				//
+				// FIXME: Add return value
+				//
+				// Bucket is full
+				return false;
+			}
 
-		for (uint32_t i = 0; i < COLLISION_SIZE; ++i)
-		{
-			KeyValue* pExpected = nullptr;
-			if (m_bucket[i].compare_exchange_strong(pExpected, pKeyValue))
+			// Claim the lowest free slot, if another thread claimed it first retry with the updated occupancy
+			const uint64_t slot = freeSlots & (0 - freeSlots);
+			occupancy = m_occupancy.fetch_or(slot);
+			if ((occupancy & slot) == 0)
 			{
+				const uint32_t index = CountTrailingZeros(slot);
+				// Fingerprint is written before the slot is published
+				m_fingerprints.Set(index, GetFingerprint(pKeyValue->k.load().hash));
+				m_bucket[index].store(pKeyValue);
 				return true;
-			} // else index already in use
+			}
 		}
-
-		// Item was not added
-		--m_usageCounter;
-		return false;
 	}
 
-	inline bool TakeValue(const K& k, const uint32_t hash, KeyValue** ppKeyValue) noexcept
+	inline bool TakeValue(const K& k, const HashType hash, KeyValue** ppKeyValue) noexcept
 	{
-		if (m_usageCounter == 0)
-			return false;
+		uint32_t startIndex = 0;
+		return TakeValue(startIndex, k, hash, ppKeyValue);
+	}
 
-		for (uint32_t i = 0; i < COLLISION_SIZE; ++i)
+	//! \brief Takes the values of \p k, passing each to \p f and then the nodes to \p release
+	//! \return true if \p f requested to stop
+	template <typename F, typename R>
+	inline bool TakeValues(const K& k, const HashType hash, F&& f, R&& release) noexcept
+	{
+		for (uint64_t candidates = GetCandidates(hash); candidates != 0; candidates &= (candidates - 1))
 		{
-			// Check if Bucket was emptied while accessing
-			if (m_usageCounter == 0)
-			{
-				//
-				// FIXME: Add return value
-				//
-				return false;
-			}
-
+			const uint32_t i = CountTrailingZeros(candidates);
 			KeyValue* pCandidate = m_bucket[i];
 			if (pCandidate == nullptr)
 			{
 				continue;
 			}
-			else if (KeyHashPair kp{hash, k}; pCandidate->k.compare_exchange_strong(kp, KeyHashPair()))
+			else if (ClaimCandidate(i, pCandidate, hash, k))
 			{
 				if (!m_bucket[i].compare_exchange_strong(pCandidate, nullptr))
 				{
 					// This shouldn't be possible
 					// throw std::logic_error("HashMap went booboo");
 					//
-					// FIXME: Add return an enumerated return value
+					// FIXME: Add return value
 					//
-					ERROR("LOGIC ERROR!");
-					return false;
+					return true;
 				}
-				*ppKeyValue = pCandidate;
-				--m_usageCounter;
-				return true;
+				ReleaseSlot(i);
+
+				const bool proceed = f(pCandidate->v);
+				release(pCandidate);
+				if (!proceed)
+					return true;
 			}
 		}
 		return false;
 	}
 
-	inline void TakeValue(const K& k,
-	                      const uint32_t hash,
-	                      const std::function<bool(const V&)>& f,
-	                      const std::function<void(KeyValue*)>& release) noexcept
+	//! \brief Takes the first item of \p k, whose value satisfies \p pred
+	//! \details Trivially copyable values are copied for \p pred, and the item is claimed only once \p pred accepted
+	//!			 the copy. Other values are seen by \p pred in the node, which is reserved meanwhile by clearing its key,
+	//!			 and the key is restored if \p pred rejects the value. Other takes wait for a reserved item rather than
+	//!			 missing it, see ClaimCandidate. Caller must pin the map, see TakeSlot.
+	template <typename P>
+	inline bool TakeValueIf(const K& k, const HashType hash, P& pred, KeyValue** ppKeyValue) noexcept
 	{
-		if (m_usageCounter == 0)
-			return;
-
-		for (uint32_t i = 0; i < COLLISION_SIZE; ++i)
+		for (uint64_t candidates = GetCandidates(hash); candidates != 0; candidates &= (candidates - 1))
 		{
-			// Check if Bucket was emptied while accessing
-			if (m_usageCounter == 0)
-			{
-				//
-				// FIXME: Add return value ?
-				//
-				break;
-			}
-
+			const uint32_t i = CountTrailingZeros(candidates);
 			KeyValue* pCandidate = m_bucket[i];
 			if (pCandidate == nullptr)
-			{
 				continue;
+
+			if constexpr (TAKE_IF_COPIES)
+			{
+				// Node isn't recycled while the map is pinned, so its value is unchanged as long as it holds the key
+				const KeyHashPair key = pCandidate->k.load();
+				if (key.hash != hash || !(key.key == k))
+					continue;
+				const V value = pCandidate->v;
+				if (!pred(value) || !pCandidate->ClaimKey(hash, k))
+					continue;
 			}
-			else if (KeyHashPair kp{hash, k}; pCandidate->k.compare_exchange_strong(kp, KeyHashPair()))
+			else
 			{
-				if (!m_bucket[i].compare_exchange_strong(pCandidate, nullptr))
+				if (!ClaimCandidate(i, pCandidate, hash, k))
+					continue;
+				if (!pred(static_cast<const V&>(pCandidate->v)))
 				{
-					// This shouldn't be possible
-					// throw std::logic_error("HashMap went booboo");
-					//
-					// FIXME: Add return value
-					//
-					return;
+					pCandidate->k.store(KeyHashPair::Make(hash, k));
+					continue;
 				}
-				--m_usageCounter;
+			}
 
-				if (!f(pCandidate->v))
-					break;
+			if (!m_bucket[i].compare_exchange_strong(pCandidate, nullptr))
+			{
+				// This shouldn't be possible, see TakeValue
+				return false;
+			}
+			ReleaseSlot(i);
+			*ppKeyValue = pCandidate;
+			return true;
+		}
+		return false;
+	}
 
-				release(pCandidate);
+	//! \brief Takes every item of the bucket, passing each to \p f(key, value) and then the node to \p release
+	//! \return Number of items taken
+	template <typename F, typename R>
+	inline uint32_t TakeAll(F&& f, R&& release) noexcept
+	{
+		uint32_t taken = 0;
+		for (uint64_t occupied = m_occupancy.load(); occupied != 0; occupied &= (occupied - 1))
+		{
+			KeyHashPair key;
+			if (KeyValue* pKeyValue = TakeSlot(CountTrailingZeros(occupied), key))
+			{
+				f(static_cast<const K&>(key.key), pKeyValue->v);
+				release(pKeyValue);
+				++taken;
+			}
+		}
+		return taken;
+	}
+
+	//! \brief Takes the first item of the bucket, whatever its key
+	//! \param[out] k		Key of the item taken
+	//! \param[out] hash	Hash of \p k
+	inline bool TakeAny(K& k, HashType& hash, KeyValue** ppKeyValue) noexcept
+	{
+		for (uint64_t occupied = m_occupancy.load(); occupied != 0; occupied &= (occupied - 1))
+		{
+			KeyHashPair key;
+			if (KeyValue* pKeyValue = TakeSlot(CountTrailingZeros(occupied), key))
+			{
+				hash = key.hash;
+				k = std::move(key.key);
+				*ppKeyValue = pKeyValue;
+				return true;
 			}
 		}
+		return false;
+	}
+
+	//! \brief Returns the number of items in the bucket (including items being added or taken)
+	inline uint32_t GetUsage() const noexcept
+	{
+		return PopCount(m_occupancy.load(std::memory_order_relaxed));
+	}
+
+	//! \brief Returns the distance of the farthest following bucket, which may hold items overflown from this bucket
+	inline uint32_t GetOverflow() const noexcept
+	{
+		return m_overflow & OVERFLOW_MAX_DISTANCE;
+	}
+
+	//! \brief Returns the overflow hint along with its update count, see LowerOverflow
+	inline uint32_t GetOverflowState() const noexcept
+	{
+		return m_overflow;
+	}
+
+	//! \brief Records that an item of this bucket may be stored \p distance buckets after this one
+	//! \details Every call counts as an update, even if the hint already covers \p distance, so that a concurrent
+	//!			 LowerOverflow, which may have missed the item, fails.
+	inline void RaiseOverflow(const uint32_t distance) noexcept
+	{
+		uint32_t current = m_overflow;
+		while (!m_overflow.compare_exchange_weak(
+		    current, NextOverflow(current, std::max(current & OVERFLOW_MAX_DISTANCE, distance))))
+		{
+		}
+	}
+
+	//! \brief Lowers the overflow hint to \p distance, unless it was updated after \p observed was read
+	inline bool LowerOverflow(uint32_t observed, const uint32_t distance) noexcept
+	{
+		return m_overflow.compare_exchange_strong(observed, NextOverflow(observed, distance));
+	}
+
+	//! \brief Returns true, if the bucket may hold an item, whose hash satisfies \p pred
+	//! \details Slots being filled or emptied, and items reserved by TakeValueIf, can't be told apart, so they count
+	//!			 as matching. Caller must pin the map, since the nodes in the slots may be taken meanwhile.
+	template <typename P>
+	inline bool MayHold(P&& pred) const noexcept
+	{
+		for (uint64_t occupied = m_occupancy.load(); occupied != 0; occupied &= (occupied - 1))
+		{
+			const KeyValue* pCandidate = m_bucket[CountTrailingZeros(occupied)];
+			if (pCandidate == nullptr)
+				return true;
+
+			const KeyHashPair key = pCandidate->k.load();
+			if (IsCleared(key) || pred(key.hash))
+				return true;
+		}
+		return false;
+	}
+
+	//! \brief Announces a waiter for items of this bucket
+	//! \details Bit 0 of the sequence flags waiters, adders bump the sequence only while it's set. A waiter
+	//!			 announces itself before it looks for its item, so an item published meanwhile changes the sequence.
+	//! \return Sequence to be passed to WaitForAdd
+	inline uint32_t AnnounceWaiter() noexcept
+	{
+		return m_sequence.fetch_or(1) | 1;
+	}
+
+	//! \brief Blocks until an item is added after \p sequence was announced, or until \p deadline
+	inline void WaitForAdd(const uint32_t sequence, const std::chrono::steady_clock::time_point deadline) noexcept
+	{
+		WaitOnWord(m_sequence, sequence, deadline);
 	}
 
+	//! \brief Wakes the waiters of this bucket, called after an item of the bucket was published
+	inline void NotifyWaiters() noexcept
+	{
+		// Without waiters this is a single load, the increment clears the flag by carrying into the sequence
+		if (m_sequence.load() & 1)
+		{
+			m_sequence.fetch_add(1);
+			NotifyWord(m_sequence);
+		}
+	}
+
+	//! \brief Prefetches the slots of the bucket and the fields, which filter them
+	inline void Prefetch() const noexcept
+	{
+		// Slots of larger buckets span several cache lines
+		for (uint32_t i = 0; i < COLLISION_SIZE; i += CACHE_LINE_SIZE / sizeof(KeyValue*))
+			::Prefetch(&m_bucket[i]);
+		::Prefetch(&m_occupancy);
+		::Prefetch(&m_fingerprints);
+	}
+
+	//! \brief Prefetches the nodes in the slots, whose fingerprint matches \p hash
+	inline void PrefetchCandidates(const HashType hash) const noexcept
+	{
+		for (uint64_t candidates = GetCandidates(hash); candidates != 0; candidates &= (candidates - 1))
+		{
+			if (const KeyValue* pCandidate = m_bucket[CountTrailingZeros(candidates)].load(std::memory_order_relaxed))
+				::Prefetch(pCandidate);
+		}
+	}
+
+	//! \brief Iterator taking the items of a key, taken nodes are passed to \p Releaser when the iterator moves on
+	template <typename Releaser>
 	class Iterator
 	{
 	public:
-		typedef BucketInsertTake<K, V, COLLISION_SIZE> Bucket;
+		typedef BucketInsertTake<K, V, COLLISION_SIZE, HashType> Bucket;
 
 		inline Iterator() noexcept
-		    : _release(nullptr)
+		    : _release()
 		    , _bucket(nullptr)
 		    , _current(nullptr)
 		    , _currentIndex(0)
@@ -497,10 +1021,7 @@ public:
 		{
 		}
 
-		inline explicit Iterator(Bucket* bucket,
-		                         const uint32_t h,
-		                         const K& k,
-		                         const std::function<void(KeyValue*)>& release) noexcept
+		inline explicit Iterator(Bucket* bucket, const HashType h, const K& k, const Releaser& release) noexcept
 		    : _release(release)
 		    , _bucket(bucket)
 		    , _current(nullptr)
@@ -539,73 +1060,153 @@ public:
 		}
 
 	private:
-		std::function<void(KeyValue*)> _release;
+		Releaser _release;
 		Bucket* _bucket;
 		KeyValue* _current;
 		uint32_t _currentIndex;
-		uint32_t _hash;
+		HashType _hash;
 
 		K _k;
 	};
 
+	//! \brief Iterator type used by HashIterator, which releases taken nodes with \p Releaser
+	template <typename Releaser>
+	using IteratorOf = Iterator<Releaser>;
+
 private:
-	// Special implementation for Iterator
-	inline bool TakeValue(uint32_t& startIndex, const K& k, const uint32_t hash, KeyValue** ppKeyValue) noexcept
+	// Special implementation for Iterator, scan starts from \p startIndex and wraps around the end of the bucket
+	inline bool TakeValue(uint32_t& startIndex, const K& k, const HashType hash, KeyValue** ppKeyValue) noexcept
 	{
 		TRACE(typeid(BucketInsertTake<K, V, COLLISION_SIZE>).name(), " TakeValue() from ", startIndex);
-		if (m_usageCounter == 0)
+		const uint64_t matching = GetCandidates(hash);
+		if (matching == 0)
 		{
-			DEBUG(typeid(BucketInsertTake<K, V, COLLISION_SIZE>).name(), " TakeValue() Bucket is empty");
+			DEBUG(typeid(BucketInsertTake<K, V, COLLISION_SIZE>).name(), " TakeValue() no candidates in bucket");
 			return false;
 		}
 
-		for (uint32_t i = 0; i < COLLISION_SIZE; ++i)
+		// Slots from startIndex upwards are scanned first, then the slots before it
+		const uint64_t candidateSets[2] = {matching & ~LowBitsMask(startIndex), matching & LowBitsMask(startIndex)};
+		for (uint64_t candidates : candidateSets)
 		{
-			// Check if Bucket was emptied while accessing
-			if (m_usageCounter == 0)
+			for (; candidates != 0; candidates &= (candidates - 1))
 			{
-				//
-				// FIXME: Add return value
-				//
-				return false;
-			}
-			const uint32_t actualIdx = (i + startIndex) % COLLISION_SIZE;
+				const uint32_t actualIdx = CountTrailingZeros(candidates);
 
-			KeyValue* pCandidate = m_bucket[actualIdx];
-			if (pCandidate == nullptr)
-			{
-				continue;
-			}
-			else if (KeyHashPair kp{hash, k}; pCandidate->k.compare_exchange_strong(kp, KeyHashPair()))
-			{
-				TRACE(typeid(BucketInsertTake<K, V, COLLISION_SIZE>).name(),
-				      " TakeValue() item found on index ",
-				      actualIdx);
-
-				if (!m_bucket[actualIdx].compare_exchange_strong(pCandidate, nullptr))
+				KeyValue* pCandidate = m_bucket[actualIdx];
+				if (pCandidate == nullptr)
 				{
-					// This shouldn't be possible
-					// throw std::logic_error("HashMap went booboo");
-					//
-					// FIXME: Add return an enumerated return value
-					//
-					ERROR(typeid(BucketInsertTake<K, V, COLLISION_SIZE>).name(),
-					      " TakeValue() ERROR: Failed to take ownership of ",
-					      actualIdx);
-					return false;
+					continue;
 				}
+				else if (ClaimCandidate(actualIdx, pCandidate, hash, k))
+				{
+					TRACE(typeid(BucketInsertTake<K, V, COLLISION_SIZE>).name(),
+					      " TakeValue() item found on index ",
+					      actualIdx);
 
-				*ppKeyValue = pCandidate;
-				--m_usageCounter;
-
-				startIndex = ((actualIdx + 1) % COLLISION_SIZE);
-				return true;
+					if (!m_bucket[actualIdx].compare_exchange_strong(pCandidate, nullptr))
+					{
+						// This shouldn't be possible
+						// throw std::logic_error("HashMap went booboo");
+						//
+						// FIXME: Add return an enumerated return value
+						//
+						ERROR(typeid(BucketInsertTake<K, V, COLLISION_SIZE>).name(),
+						      " TakeValue() ERROR: Failed to take ownership of ",
+						      actualIdx);
+						return false;
+					}
+
+					*ppKeyValue = pCandidate;
+					ReleaseSlot(actualIdx);
+
+					startIndex = ((actualIdx + 1) % COLLISION_SIZE);
+					return true;
+				}
 			}
 		}
 		return false;
 	}
 
+	//! \brief Returns bitmask of the occupied slots, whose fingerprint matches the \p hash
+	inline uint64_t GetCandidates(const HashType hash) const noexcept
+	{
+		const uint64_t occupancy = m_occupancy;
+		if (occupancy == 0)
+			return 0;
+		return m_fingerprints.Match(GetFingerprint(hash)) & occupancy;
+	}
+
+	//! \brief Frees a slot, which has already been emptied, for new items
+	inline void ReleaseSlot(const uint32_t index) noexcept
+	{
+		m_occupancy.fetch_and(~(uint64_t(1) << index));
+	}
+
+	//! \brief Takes the item in slot \p index, whatever its key
+	//! \param[out] key	Key of the item
+	//! \return The node of the item, or nullptr if the slot is empty or its item is being taken by another thread
+	inline KeyValue* TakeSlot(const uint32_t index, KeyHashPair& key) noexcept
+	{
+		KeyValue* pCandidate = m_bucket[index];
+		if (pCandidate == nullptr)
+			return nullptr;
+
+		// Key of a node being taken by another thread is already cleared
+		for (key = pCandidate->k.load(); IsCleared(key); key = pCandidate->k.load())
+		{
+			if (!IsReserved(index, pCandidate))
+				return nullptr;
+			CpuRelax();
+		}
+
+		if (!pCandidate->ClaimKey(key.hash, key.key) || !m_bucket[index].compare_exchange_strong(pCandidate, nullptr))
+			return nullptr;
+		ReleaseSlot(index);
+		return pCandidate;
+	}
+
+	//! \brief Returns true if \p key is cleared, i.e. its node is being taken or is reserved by TakeValueIf
+	inline static bool IsCleared(const KeyHashPair& key) noexcept
+	{
+		const KeyHashPair cleared = KeyHashPair();
+		return key.hash == cleared.hash && key.key == cleared.key;
+	}
+
+	//! \brief Returns true if TakeValueIf may have reserved the node in slot \p index, which is \p pCandidate
+	//! \details A node being taken leaves its slot right after its key was cleared, a reserved node stays in its
+	//!			 slot until TakeValueIf's predicate has returned. Nodes are reserved only if values aren't copied.
+	inline bool IsReserved(const uint32_t index, const KeyValue* pCandidate) const noexcept
+	{
+		if constexpr (TAKE_IF_COPIES)
+			return false;
+		else
+			return m_bucket[index].load() == pCandidate && IsCleared(pCandidate->k.load());
+	}
+
+	//! \brief Claims \p pCandidate in slot \p index, if it holds \p k of \p hash
+	//! \details Waits while the node is reserved by TakeValueIf, so that the item isn't missed if it's rejected.
+	//!			 Caller must pin the map, so that \p pCandidate isn't recycled in to the slot meanwhile.
+	inline bool ClaimCandidate(const uint32_t index, KeyValue* pCandidate, const HashType hash, const K& k) noexcept
+	{
+		while (!pCandidate->ClaimKey(hash, k))
+		{
+			if (!IsReserved(index, pCandidate))
+				return false;
+			CpuRelax();
+		}
+		return true;
+	}
+
 private:
+	constexpr static const uint64_t SLOT_MASK = LowBitsMask(COLLISION_SIZE);
+
+	// TakeValueIf evaluates its predicate on copies of trivially copyable values, instead of reserving their items
+	constexpr static const bool TAKE_IF_COPIES = std::is_trivially_copyable<V>::value;
+
 	StaticArray<std::atomic<KeyValue*>, COLLISION_SIZE> m_bucket;
-	std::atomic<uint32_t> m_usageCounter; // Keys in bucket
+	std::atomic<uint64_t> m_occupancy; // Bit per slot, set while the slot is in use
+	std::atomic<uint32_t> m_overflow; // Distance of the farthest overflown item, its update count in the bits above
+	std::atomic<uint32_t> m_sequence; // Bumped by adds of items, whose first candidate is this bucket, see TakeWait
+	BucketFingerprints<COLLISION_SIZE> m_fingerprints;
 };
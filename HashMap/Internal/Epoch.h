@@ -0,0 +1,658 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <stdint.h>
+#include "HashDefines.h"
+#include "FreeList.h"
+#include "UtilityFunctions.h"
+
+//! \brief Part of an epoch record, which the registry releases when the owning thread exits
+struct EpochRecordBase
+{
+	constexpr static const uint64_t QUIESCENT = ~0ULL;
+
+	std::atomic<uint64_t> epoch{QUIESCENT}; // Epoch announced while pinned, QUIESCENT otherwise
+	std::atomic<bool> owned{false};			// Record is registered by a thread
+	std::atomic<bool> busy{false};			// Another thread collects the limbo lists of the idle record
+	uint32_t depth = 0;						// Number of nested guards of the owning thread
+	bool listed = false;					// Record is in the thread-local table of the owning thread
+	uint64_t domain = 0;					// Id of the domain of an unlisted record
+	EpochRecordBase* pNextUnlisted = nullptr; // Next unlisted record of the owning thread
+};
+
+//! \brief Tracks the live epoch domains and the record each thread registered in them
+//! \details A thread registers a record in a domain on its first pin, and finds it again through a small thread-local
+//!			 table keyed by the unique id of the domain. Records in the table are released, when the thread exits,
+//!			 which checks under a process-wide lock that the domain still exists, so records of destroyed domains
+//!			 are never touched. Entries of destroyed domains are evicted under the lock too, but only once a domain
+//!			 was destroyed after the last eviction. If the table has no free entry, the record stays unlisted: it's
+//!			 kept in a thread-local list while the domain is pinned, and released when the outermost guard ends
+//!			 (see Release), so misses of a full table never wait for the lock and records never pile up. The lock
+//!			 is otherwise only taken by constructors and destructors of domains.
+class EpochRegistry
+{
+public:
+	struct Domain
+	{
+		uint64_t id;
+		Domain* pPrev;
+		Domain* pNext;
+	};
+
+	inline static void Add(Domain& domain) noexcept
+	{
+		static std::atomic<uint64_t> ids{1};
+		domain.id = ids++;
+
+		std::lock_guard<std::mutex> guard(Lock());
+		domain.pPrev = nullptr;
+		domain.pNext = Head();
+		if (Head())
+			Head()->pPrev = &domain;
+		Head() = &domain;
+	}
+
+	inline static void Remove(Domain& domain) noexcept
+	{
+		std::lock_guard<std::mutex> guard(Lock());
+		(domain.pPrev ? domain.pPrev->pNext : Head()) = domain.pNext;
+		if (domain.pNext)
+			domain.pNext->pPrev = domain.pPrev;
+		Removals().fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//! \brief Record the calling thread registered in domain \p id, nullptr if none
+	inline static EpochRecordBase* Find(const uint64_t id) noexcept
+	{
+		ThreadRecords& thread = Thread();
+		Entry* entries = thread.entries;
+		if (entries[id % EPOCH_THREAD_DOMAINS].id == id)
+			return entries[id % EPOCH_THREAD_DOMAINS].pRecord;
+		for (uint32_t i = 0; i < EPOCH_THREAD_DOMAINS; ++i)
+		{
+			if (entries[i].id == id)
+				return entries[i].pRecord;
+		}
+		// Unlisted records are kept only while pinned, so the list is as long as the nesting of their guards
+		for (EpochRecordBase* pRecord = thread.pUnlisted; pRecord; pRecord = pRecord->pNextUnlisted)
+		{
+			if (pRecord->domain == id)
+				return pRecord;
+		}
+		return nullptr;
+	}
+
+	//! \brief Remembers \p pRecord as the record of the calling thread in domain \p id
+	//! \details A full table evicts the entries of destroyed domains, if any was destroyed since the last eviction.
+	//!			 Otherwise \p pRecord stays unlisted, and the domain must release it by calling Release, once the
+	//!			 record is no longer pinned.
+	inline static void Insert(const uint64_t id, EpochRecordBase* pRecord) noexcept
+	{
+		ThreadRecords& thread = Thread();
+		Entry* pEntry = FindFree(thread, id);
+		if (!pEntry && Removals().load(std::memory_order_relaxed) != thread.removals)
+		{
+			std::lock_guard<std::mutex> guard(Lock());
+			thread.removals = Removals().load(std::memory_order_relaxed);
+			for (Entry& entry : thread.entries)
+			{
+				if (!IsAlive(entry.id))
+					entry = Entry{};
+			}
+			pEntry = FindFree(thread, id);
+		}
+
+		pRecord->listed = pEntry != nullptr;
+		if (pEntry)
+		{
+			*pEntry = Entry{id, pRecord};
+		}
+		else
+		{
+			pRecord->domain = id;
+			pRecord->pNextUnlisted = thread.pUnlisted;
+			thread.pUnlisted = pRecord;
+		}
+	}
+
+	//! \brief Releases \p pRecord of the calling thread, if it is unlisted, called when its outermost guard ends
+	//! \details The caller's domain is alive, so the record is released without the lock.
+	inline static void Release(EpochRecordBase& record) noexcept
+	{
+		if (record.listed)
+			return;
+
+		EpochRecordBase** ppLink = &Thread().pUnlisted;
+		while (*ppLink != &record)
+			ppLink = &(*ppLink)->pNextUnlisted;
+		*ppLink = record.pNextUnlisted;
+		record.pNextUnlisted = nullptr;
+		record.owned.store(false, std::memory_order_release);
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t id;
+		EpochRecordBase* pRecord;
+	};
+
+	struct ThreadRecords
+	{
+		Entry entries[EPOCH_THREAD_DOMAINS] = {};
+		EpochRecordBase* pUnlisted = nullptr; // Records, which didn't fit in to the table, see Release
+		uint64_t removals = 0;				  // Removals at the last eviction of entries of destroyed domains
+
+		inline ~ThreadRecords() noexcept
+		{
+			std::lock_guard<std::mutex> guard(Lock());
+			for (Entry& entry : entries)
+			{
+				if (entry.id && IsAlive(entry.id))
+					entry.pRecord->owned.store(false, std::memory_order_release);
+			}
+		}
+	};
+
+	inline static ThreadRecords& Thread() noexcept
+	{
+		thread_local ThreadRecords records;
+		return records;
+	}
+
+	inline static std::mutex& Lock() noexcept
+	{
+		static std::mutex lock;
+		return lock;
+	}
+
+	inline static Domain*& Head() noexcept
+	{
+		static Domain* pHead = nullptr;
+		return pHead;
+	}
+
+	//! \brief Number of domains destroyed so far
+	inline static std::atomic<uint64_t>& Removals() noexcept
+	{
+		static std::atomic<uint64_t> removals{0};
+		return removals;
+	}
+
+	//! \brief Returns a free entry of the table of \p thread for domain \p id, nullptr if the table is full
+	inline static Entry* FindFree(ThreadRecords& thread, const uint64_t id) noexcept
+	{
+		for (uint32_t i = 0; i < EPOCH_THREAD_DOMAINS; ++i)
+		{
+			if (thread.entries[(id + i) % EPOCH_THREAD_DOMAINS].id == 0)
+				return &thread.entries[(id + i) % EPOCH_THREAD_DOMAINS];
+		}
+		return nullptr;
+	}
+
+	//! \brief Checks if domain \p id still exists, called with the lock held
+	inline static bool IsAlive(const uint64_t id) noexcept
+	{
+		for (Domain* pDomain = Head(); pDomain; pDomain = pDomain->pNext)
+		{
+			if (pDomain->id == id)
+				return true;
+		}
+		return false;
+	}
+};
+
+//! \brief Epoch-based reclamation of nodes, which concurrent operations may still use after they were released
+//! \details Each thread registers a record in the domain once, on its first pin. An operation pins the domain by
+//!			 storing the global epoch in its record, followed by a fence, so pinning needs no atomic
+//!			 read-modify-write and never waits for other threads. Released nodes are retired to the limbo list of
+//!			 the record with the global epoch at the time of release, linked through the links of the free-list.
+//!			 The global epoch only advances, when every pinned record announces it, so nodes retired in epoch e
+//!			 cannot be used by any operation, once the global epoch is e + 2. Every EPOCH_BATCH retired nodes, the
+//!			 thread tries to advance the epoch and recycles its expired limbo lists, one chain each.
+//!
+//!			 Collect gathers the expired nodes of idle records, including those of exited threads, when the free-list
+//!			 runs dry. It flags the record busy first and backs off, if the record is pinned. A thread, which pins
+//!			 its record while it's collected, sees the flag and pushes the nodes it retires to a deferred stack
+//!			 instead of waiting, they are moved to the limbo lists by its next retire or by a later Collect.
+//!			 Each record counts the nodes retired to it and recycled from it, so CollectPending can tell nodes
+//!			 waiting for their epoch to expire from a pool, which has really run dry.
+//!
+//!			 The domain holds EPOCH_SLOTS records, further threads register records allocated from the heap in
+//!			 chunks of EPOCH_SLOTS. Only if that allocation fails, a thread waits for another one to release its
+//!			 record.
+//! \tparam Links	Chains the retired items with Link(pItem, pNext) and Next(pItem), the free-list of the nodes by default
+template <typename T, bool ENABLED, typename Links = TaggedFreeList<T>>
+class EpochDomain
+{
+	constexpr static const uint64_t QUIESCENT = EpochRecordBase::QUIESCENT;
+	constexpr static const uint32_t LIMBO_LISTS = 3;
+
+	struct Limbo
+	{
+		T* pFirst;
+		T* pLast;
+		uint64_t epoch;
+		uint32_t count;
+	};
+
+	struct alignas(CACHE_LINE_SIZE) Record : EpochRecordBase
+	{
+		std::atomic<uint32_t> retired{0};  // Nodes retired by the owning thread, written by the owner only
+		std::atomic<uint32_t> recycled{0}; // Nodes recycled from the limbo lists, written by the thread holding them
+		Limbo limbo[LIMBO_LISTS] = {};	   // Nodes retired in epochs e, e + 1 and e + 2, indexed by e % LIMBO_LISTS
+		std::atomic<T*> deferred{nullptr}; // Nodes retired while another thread collected the limbo lists
+	};
+
+	struct Chunk
+	{
+		Record records[EPOCH_SLOTS];
+		Chunk* pNext = nullptr;
+	};
+
+public:
+	//! \brief Keeps the domain pinned by the calling thread until destroyed
+	class Guard
+	{
+	public:
+		inline explicit Guard(EpochDomain& domain) noexcept
+		    : m_pDomain(&domain)
+		    , m_pRecord(domain.Enter())
+		{
+		}
+
+		inline ~Guard() noexcept
+		{
+			m_pDomain->Leave(*m_pRecord);
+		}
+
+		DISABLE_COPY_MOVE(Guard)
+
+	private:
+		EpochDomain* m_pDomain;
+		Record* m_pRecord;
+	};
+
+	//! \param links Free-list, whose links chain the retired nodes
+	inline explicit EpochDomain(Links& links) noexcept
+	    : m_pLinks(&links)
+	    , m_epoch(0)
+	    , m_pChunks(nullptr)
+	{
+		EpochRegistry::Add(m_domain);
+	}
+
+	inline ~EpochDomain() noexcept
+	{
+		EpochRegistry::Remove(m_domain);
+		for (Chunk* pChunk = m_pChunks.load(); pChunk;)
+		{
+			Chunk* pNext = pChunk->pNext;
+			delete pChunk;
+			pChunk = pNext;
+		}
+	}
+
+	//! \brief Pins the domain until the returned guard is destroyed
+	inline Guard Pin() noexcept
+	{
+		return Guard(*this);
+	}
+
+	//! \brief Retires \p pItem, it's passed to \p recycle(pFirst, pLast) in a chain of expired nodes, once no pinned
+	//!		   operation can use it anymore
+	//! \details The domain is pinned for the call, unless the calling thread has already pinned it
+	template <typename R>
+	inline void Retire(T* pItem, R&& recycle) noexcept
+	{
+		Record& record = *OwnRecord();
+		if (record.depth > 0)
+		{
+			RetireTo(record, pItem, recycle);
+		}
+		else
+		{
+			Guard guard(*this);
+			RetireTo(record, pItem, recycle);
+		}
+	}
+
+	//! \brief Passes the expired nodes of all idle records to \p recycle(pFirst, pLast)
+	//! \param attempts	Number of times the epoch is advanced and the records are checked, until a node is recycled
+	//! \return Number of nodes recycled
+	template <typename R>
+	inline uint32_t Collect(R&& recycle, const uint32_t attempts = EPOCH_COLLECT_ATTEMPTS) noexcept
+	{
+		// Nodes of the current epoch expire after two advances, which pinned operations may delay
+		for (uint32_t attempt = 0; attempt < attempts; ++attempt)
+		{
+			TryAdvance();
+			TryAdvance();
+
+			uint32_t collected = 0;
+			ForEachRecord([&](Record& record) {
+				if (record.epoch.load(std::memory_order_relaxed) == QUIESCENT
+				    && !record.busy.load(std::memory_order_relaxed) && !record.busy.exchange(true))
+				{
+					// Seq-cst exchange and load pair with the fence of Enter: either the owner sees busy, or the
+					// record is seen pinned
+					if (record.epoch.load() == QUIESCENT)
+					{
+						collected += FlushExpired(record, recycle);
+						// Nodes the owner deferred, before it left, wait for the epoch like the others
+						MergeDeferred(record);
+					}
+					record.busy.store(false, std::memory_order_release);
+				}
+				return true;
+			});
+			if (collected)
+				return collected;
+			CpuRelax();
+		}
+		return 0;
+	}
+
+	//! \brief Collect, which keeps trying while retired nodes wait for pinned operations to end
+	//! \details A thread preempted while pinned holds back the epoch, so the nodes retired meanwhile cannot be
+	//!			 recycled before it runs again. The calling thread yields to it, unless it has pinned the domain itself,
+	//!			 since its own pin would then hold back the epoch forever.
+	//! \return Number of nodes recycled, zero if no node is waiting in a limbo list
+	template <typename R>
+	inline uint32_t CollectPending(R&& recycle) noexcept
+	{
+		for (;;)
+		{
+			if (const uint32_t collected = Collect(recycle))
+				return collected;
+			if (!HasPending() || IsPinnedByCaller())
+				return 0;
+			std::this_thread::yield();
+		}
+	}
+
+	DISABLE_COPY_MOVE(EpochDomain)
+
+private:
+	//! \brief Announces the current epoch in the record of the calling thread, unless it's pinned already
+	inline Record* Enter() noexcept
+	{
+		Record* pRecord = OwnRecord();
+		if (pRecord->depth++ == 0)
+		{
+			pRecord->epoch.store(m_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			// Orders the announcement before the reads of the operation and the check of busy in RetireTo
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+		}
+		return pRecord;
+	}
+
+	inline void Leave(Record& record) noexcept
+	{
+		if (--record.depth == 0)
+		{
+			if (record.deferred.load(std::memory_order_relaxed) && !record.busy.load(std::memory_order_acquire))
+				MergeDeferred(record);
+			record.epoch.store(QUIESCENT, std::memory_order_release);
+			EpochRegistry::Release(record);
+		}
+	}
+
+	//! \brief Checks if the calling thread has pinned the domain
+	inline bool IsPinnedByCaller() const noexcept
+	{
+		const EpochRecordBase* pRecord = EpochRegistry::Find(m_domain.id);
+		return pRecord && pRecord->depth > 0;
+	}
+
+	//! \brief Checks if any record holds retired nodes, which are not recycled yet
+	inline bool HasPending() noexcept
+	{
+		bool pending = false;
+		ForEachRecord([&](Record& record) {
+			pending = record.retired.load(std::memory_order_relaxed) != record.recycled.load(std::memory_order_relaxed);
+			return !pending;
+		});
+		return pending;
+	}
+
+	//! \brief Record of the calling thread, registered on its first pin
+	inline Record* OwnRecord() noexcept
+	{
+		EpochRecordBase* pRecord = EpochRegistry::Find(m_domain.id);
+		if (!pRecord)
+			pRecord = Register();
+		return static_cast<Record*>(pRecord);
+	}
+
+	inline Record* Register() noexcept
+	{
+		for (;;)
+		{
+			Record* pRecord = nullptr;
+			const uint32_t first = GetThreadSlot() % EPOCH_SLOTS;
+			for (uint32_t i = 0; i < EPOCH_SLOTS && !pRecord; ++i)
+				pRecord = TryClaim(m_records[(first + i) % EPOCH_SLOTS]);
+			for (Chunk* pChunk = m_pChunks.load(std::memory_order_acquire); pChunk && !pRecord; pChunk = pChunk->pNext)
+			{
+				for (uint32_t i = 0; i < EPOCH_SLOTS && !pRecord; ++i)
+					pRecord = TryClaim(pChunk->records[i]);
+			}
+
+			if (pRecord)
+			{
+				EpochRegistry::Insert(m_domain.id, pRecord);
+				return pRecord;
+			}
+
+			Chunk* pChunk = new (std::nothrow) Chunk();
+			if (pChunk)
+			{
+				pChunk->pNext = m_pChunks.load(std::memory_order_relaxed);
+				while (!m_pChunks.compare_exchange_weak(pChunk->pNext, pChunk, std::memory_order_release))
+				{
+				}
+			}
+			else
+			{
+				CpuRelax(); // Out of memory, wait for a thread to release its record
+			}
+		}
+	}
+
+	inline static Record* TryClaim(Record& record) noexcept
+	{
+		if (!record.owned.load(std::memory_order_relaxed) && !record.owned.exchange(true, std::memory_order_acquire))
+			return &record;
+		return nullptr;
+	}
+
+	//! \brief Calls \p f for each record, until it returns false
+	template <typename F>
+	inline void ForEachRecord(F&& f) noexcept
+	{
+		for (Record& record : m_records)
+		{
+			if (!f(record))
+				return;
+		}
+		for (Chunk* pChunk = m_pChunks.load(std::memory_order_acquire); pChunk; pChunk = pChunk->pNext)
+		{
+			for (Record& record : pChunk->records)
+			{
+				if (!f(record))
+					return;
+			}
+		}
+	}
+
+	template <typename R>
+	inline void RetireTo(Record& record, T* pItem, R& recycle) noexcept
+	{
+		// Counted first, so the node is pending wherever it's kept
+		record.retired.store(record.retired.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (record.busy.load(std::memory_order_acquire))
+		{
+			// Another thread collects the limbo lists, which it saw idle before the record was pinned
+			T* pHead = record.deferred.load(std::memory_order_relaxed);
+			do
+			{
+				m_pLinks->Link(pItem, pHead);
+			} while (!record.deferred.compare_exchange_weak(pHead, pItem, std::memory_order_release));
+			return;
+		}
+
+		// The epoch is read after pItem was unlinked, operations which may still use it announce this epoch or an
+		// earlier one
+		const uint64_t epoch = m_epoch.load();
+		Limbo& limbo = record.limbo[epoch % LIMBO_LISTS];
+		if (limbo.epoch != epoch)
+		{
+			// List holds nodes of epoch - LIMBO_LISTS or earlier, which have expired
+			if (limbo.pFirst)
+				Recycle(record, limbo, recycle);
+			limbo = Limbo{nullptr, nullptr, epoch, 0};
+		}
+
+		Prepend(limbo, pItem, pItem, 1);
+		// Deferred nodes were retired in this epoch or an earlier one
+		MergeDeferred(record);
+
+		if (record.retired.load(std::memory_order_relaxed) % EPOCH_BATCH == 0)
+		{
+			TryAdvance();
+			FlushExpired(record, recycle);
+		}
+	}
+
+	//! \brief Moves the deferred nodes to the limbo list of the current epoch, if it doesn't hold expired nodes
+	//! \details Called by the thread holding the limbo lists, while the owner may still push to the deferred stack
+	inline void MergeDeferred(Record& record) noexcept
+	{
+		if (!record.deferred.load(std::memory_order_relaxed))
+			return;
+
+		const uint64_t epoch = m_epoch.load();
+		Limbo& limbo = record.limbo[epoch % LIMBO_LISTS];
+		if (limbo.pFirst && limbo.epoch != epoch)
+			return;
+
+		T* pFirst = record.deferred.exchange(nullptr, std::memory_order_acquire);
+		if (!pFirst)
+			return;
+
+		uint32_t count = 1;
+		T* pLast = pFirst;
+		for (T* pNext = m_pLinks->Next(pLast); pNext; pNext = m_pLinks->Next(pLast))
+		{
+			pLast = pNext;
+			++count;
+		}
+
+		if (!limbo.pFirst)
+			limbo = Limbo{nullptr, nullptr, epoch, 0};
+		Prepend(limbo, pFirst, pLast, count);
+	}
+
+	inline void Prepend(Limbo& limbo, T* pFirst, T* pLast, const uint32_t count) noexcept
+	{
+		m_pLinks->Link(pLast, limbo.pFirst);
+		limbo.pFirst = pFirst;
+		if (!limbo.pLast)
+			limbo.pLast = pLast;
+		limbo.count += count;
+	}
+
+	//! \brief Passes the limbo lists of \p record, whose nodes have expired, to \p recycle
+	//! \return Number of nodes recycled
+	template <typename R>
+	inline uint32_t FlushExpired(Record& record, R& recycle) noexcept
+	{
+		uint32_t flushed = 0;
+		const uint64_t epoch = m_epoch.load();
+		for (Limbo& limbo : record.limbo)
+		{
+			if (limbo.pFirst && limbo.epoch + 2 <= epoch)
+			{
+				flushed += limbo.count;
+				Recycle(record, limbo, recycle);
+				limbo = Limbo{nullptr, nullptr, limbo.epoch, 0};
+			}
+		}
+		return flushed;
+	}
+
+	//! \brief Passes the nodes of \p limbo to \p recycle, and counts them recycled from \p record
+	template <typename R>
+	inline void Recycle(Record& record, const Limbo& limbo, R& recycle) noexcept
+	{
+		recycle(limbo.pFirst, limbo.pLast);
+		record.recycled.store(record.recycled.load(std::memory_order_relaxed) + limbo.count, std::memory_order_relaxed);
+	}
+
+	//! \brief Advances the global epoch, if every pinned record announces the current one
+	inline void TryAdvance() noexcept
+	{
+		uint64_t epoch = m_epoch.load();
+		bool advance = true;
+		ForEachRecord([&](Record& record) {
+			const uint64_t announced = record.epoch.load();
+			advance = (announced == QUIESCENT || announced == epoch);
+			return advance;
+		});
+		if (advance)
+			m_epoch.compare_exchange_strong(epoch, epoch + 1);
+	}
+
+private:
+	Links* m_pLinks;
+	EpochRegistry::Domain m_domain;
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_epoch;
+	std::atomic<Chunk*> m_pChunks; // Records of threads beyond the first EPOCH_SLOTS
+	Record m_records[EPOCH_SLOTS];
+};
+
+//! \brief Reclamation disabled, nodes are recycled as soon as they are retired
+template <typename T, typename Links>
+class EpochDomain<T, false, Links>
+{
+public:
+	struct Guard
+	{
+		// User-provided, so a guard held only for its scope isn't reported as unused
+		inline ~Guard() noexcept
+		{
+		}
+	};
+
+	inline explicit EpochDomain(Links&) noexcept
+	{
+	}
+
+	inline Guard Pin() noexcept
+	{
+		return Guard();
+	}
+
+	template <typename R>
+	inline void Retire(T* pItem, R&& recycle) noexcept
+	{
+		recycle(pItem, pItem);
+	}
+
+	template <typename R>
+	inline uint32_t Collect(R&&, const uint32_t = EPOCH_COLLECT_ATTEMPTS) noexcept
+	{
+		return 0;
+	}
+
+	template <typename R>
+	inline uint32_t CollectPending(R&&) noexcept
+	{
+		return 0;
+	}
+
+	DISABLE_COPY_MOVE(EpochDomain)
+};
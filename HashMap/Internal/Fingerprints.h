@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <type_traits>
+#include <stdint.h>
+#include "HashDefines.h"
+#include "UtilityFunctions.h"
+
+// Define HASH_DISABLE_SIMD to force the scalar implementation
+#if !defined(HASH_DISABLE_SIMD) && defined(__AVX2__)
+#define HASH_FINGERPRINTS_AVX2 1
+#define HASH_FINGERPRINTS_SSE2 1
+#include <immintrin.h>
+#elif !defined(HASH_DISABLE_SIMD) \
+    && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define HASH_FINGERPRINTS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//! \brief Returns the fingerprint of a hash, i.e. the top byte, which is the last to be used for selecting the bucket
+template <typename HashType>
+constexpr inline uint8_t GetFingerprint(const HashType hash) noexcept
+{
+	static_assert(std::is_unsigned<HashType>::value, "Hash must be an unsigned integer");
+	return uint8_t(hash >> (8 * sizeof(HashType) - 8));
+}
+
+//! \brief Returns a mask with the lowest \p bits bits set
+constexpr inline uint64_t LowBitsMask(const uint32_t bits) noexcept
+{
+	return bits >= 64 ? ~uint64_t(0) : ((uint64_t(1) << bits) - 1);
+}
+
+//! \brief One byte fingerprint for each slot of a bucket
+//! \details Fingerprint of a slot is written before the slot is published, so a reader can filter out
+//!			 non-matching slots without dereferencing them. Fingerprints are only a filter: a stale value is
+//!			 harmless, as matching slots are always verified against the full hash and key.
+template <uint32_t COLLISION_SIZE>
+struct BucketFingerprints
+{
+	static_assert(COLLISION_SIZE <= 64, "Bucket size cannot exceed 64 slots");
+
+	// Padded to full vector width, so that vector loads never read past the array
+	constexpr static const uint32_t PADDED_SIZE = (COLLISION_SIZE + 15) / 16 * 16;
+	constexpr static const uint64_t SLOT_MASK = LowBitsMask(COLLISION_SIZE);
+
+	inline void Set(const uint32_t index, const uint8_t fingerprint) noexcept
+	{
+		m_fingerprints[index].store(fingerprint, std::memory_order_relaxed);
+	}
+
+	//! \brief Compares all fingerprints of the bucket at once
+	//! \return Bitmask of the slots, whose fingerprint matches \p fingerprint
+	inline uint64_t Match(const uint8_t fingerprint) const noexcept
+	{
+		uint64_t mask = 0;
+		uint32_t i = 0;
+		// Fingerprints are loaded as plain bytes: std::atomic<uint8_t> has the same representation as uint8_t
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&m_fingerprints[0]);
+#if HASH_FINGERPRINTS_AVX2
+		const __m256i needle32 = _mm256_set1_epi8(char(fingerprint));
+		for (; i + 32 <= PADDED_SIZE; i += 32)
+		{
+			const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBytes + i));
+			mask |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, needle32)))) << i;
+		}
+#endif
+#if HASH_FINGERPRINTS_SSE2
+		const __m128i needle16 = _mm_set1_epi8(char(fingerprint));
+		for (; i < PADDED_SIZE; i += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBytes + i));
+			mask |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, needle16)))) << i;
+		}
+#else
+		(void)pBytes;
+		for (; i < COLLISION_SIZE; ++i)
+		{
+			if (m_fingerprints[i].load(std::memory_order_relaxed) == fingerprint)
+				mask |= uint64_t(1) << i;
+		}
+#endif
+		return mask & SLOT_MASK;
+	}
+
+	alignas(16) std::atomic<uint8_t> m_fingerprints[PADDED_SIZE];
+};
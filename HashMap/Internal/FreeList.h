@@ -0,0 +1,177 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "HashDefines.h"
+
+//! \brief Lock-free LIFO (Treiber stack) of items stored in a contiguous array
+//! \details Items are addressed by their index in the array, and the links between items are kept in
+//!			 a separate array of atomic pointers. The head of the stack packs the index of the first item
+//!			 together with a tag, which is incremented on every modification to prevent ABA-problems.
+//!			 Items are never freed while the list is alive, so reading a link of an item which is
+//!			 concurrently popped by another thread is harmless: the tagged CAS will simply fail.
+template <typename T>
+class TaggedFreeList
+{
+public:
+	constexpr static const uint32_t END = ~0U;
+
+	inline TaggedFreeList() noexcept
+	    : m_items(nullptr)
+	    , m_links(nullptr)
+	    , m_head(Pack(END, 0))
+	{
+	}
+
+	//! \brief Links all items in to the list, first item will be popped first
+	//! \param[in] items	Storage of the items
+	//! \param[in] links	Storage for the links, must have room for \p count items
+	//! \param[in] count	Number of items
+	inline void Init(T* items, std::atomic<T*>* links, const uint32_t count) noexcept
+	{
+		m_items = items;
+		m_links = links;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			m_links[i].store((i + 1 < count) ? &m_items[i + 1] : nullptr, std::memory_order_relaxed);
+		}
+		m_head.store(Pack(count > 0 ? 0 : END, 0));
+	}
+
+	//! \brief Initializes an empty list, items are provided later with Push
+	inline void InitEmpty(T* items, std::atomic<T*>* links) noexcept
+	{
+		m_items = items;
+		m_links = links;
+		m_head.store(Pack(END, 0));
+	}
+
+	//! \brief Pops the first item from the list
+	//! \return Popped item, or nullptr if the list is empty
+	inline T* Pop() noexcept
+	{
+		uint64_t head = m_head.load(std::memory_order_acquire);
+		for (;;)
+		{
+			const uint32_t index = Index(head);
+			if (index == END)
+				return nullptr;
+
+			T* pNext = m_links[index].load(std::memory_order_relaxed);
+			if (m_head.compare_exchange_weak(head, Pack(IndexOf(pNext), Tag(head) + 1)))
+				return &m_items[index];
+		}
+	}
+
+	//! \brief Pops up to \p count items from the list with a single CAS
+	//! \param[out] ppItems	Receives the popped items
+	//! \param[in] count	Maximum number of items to pop
+	//! \return Number of items popped
+	inline uint32_t PopBatch(T** ppItems, const uint32_t count) noexcept
+	{
+		uint64_t head = m_head.load(std::memory_order_acquire);
+		for (;;)
+		{
+			uint32_t popped = 0;
+			T* pItem = (Index(head) == END) ? nullptr : &m_items[Index(head)];
+			while (pItem && popped < count)
+			{
+				ppItems[popped++] = pItem;
+				pItem = m_links[IndexOf(pItem)].load(std::memory_order_relaxed);
+			}
+			if (popped == 0)
+				return 0;
+			// If the tag is unchanged, nothing was popped or pushed meanwhile, so the walked links are valid
+			if (m_head.compare_exchange_weak(head, Pack(IndexOf(pItem), Tag(head) + 1)))
+				return popped;
+		}
+	}
+
+	//! \brief Pushes an item to the list
+	inline void Push(T* pItem) noexcept
+	{
+		PushChain(pItem, pItem);
+	}
+
+	//! \brief Pushes \p count items to the list with a single CAS
+	inline void PushBatch(T* const* ppItems, const uint32_t count) noexcept
+	{
+		if (count == 0)
+			return;
+
+		for (uint32_t i = 0; i + 1 < count; ++i)
+		{
+			m_links[IndexOf(ppItems[i])].store(ppItems[i + 1], std::memory_order_relaxed);
+		}
+		PushChain(ppItems[0], ppItems[count - 1]);
+	}
+
+	//! \brief Pushes an already linked chain of items (from \p pFirst to \p pLast) to the list
+	inline void PushChain(T* pFirst, T* pLast) noexcept
+	{
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			const uint32_t index = Index(head);
+			m_links[IndexOf(pLast)].store(index == END ? nullptr : &m_items[index], std::memory_order_relaxed);
+			if (m_head.compare_exchange_weak(head, Pack(IndexOf(pFirst), Tag(head) + 1)))
+				return;
+		}
+	}
+
+	//! \brief Detaches the whole list, returns the first item of the detached chain (or nullptr)
+	inline T* PopAll() noexcept
+	{
+		uint64_t head = m_head.load(std::memory_order_acquire);
+		while (Index(head) != END)
+		{
+			if (m_head.compare_exchange_weak(head, Pack(END, Tag(head) + 1)))
+				return &m_items[Index(head)];
+		}
+		return nullptr;
+	}
+
+	//! \brief Returns the item linked after \p pItem
+	inline T* Next(T* pItem) const noexcept
+	{
+		return m_links[IndexOf(pItem)].load(std::memory_order_relaxed);
+	}
+
+	//! \brief Links \p pNext after \p pItem, used for building chains passed to PushChain
+	inline void Link(T* pItem, T* pNext) noexcept
+	{
+		m_links[IndexOf(pItem)].store(pNext, std::memory_order_relaxed);
+	}
+
+	inline bool IsEmpty() const noexcept
+	{
+		return Index(m_head.load()) == END;
+	}
+
+private:
+	inline uint32_t IndexOf(const T* pItem) const noexcept
+	{
+		return pItem ? uint32_t(pItem - m_items) : END;
+	}
+
+	constexpr static uint64_t Pack(const uint32_t index, const uint32_t tag) noexcept
+	{
+		return (uint64_t(tag) << 32) | index;
+	}
+
+	constexpr static uint32_t Index(const uint64_t head) noexcept
+	{
+		return uint32_t(head);
+	}
+
+	constexpr static uint32_t Tag(const uint64_t head) noexcept
+	{
+		return uint32_t(head >> 32);
+	}
+
+private:
+	T* m_items;
+	std::atomic<T*>* m_links;
+	std::atomic<uint64_t> m_head;
+
+	DISABLE_COPY_MOVE(TaggedFreeList)
+};
@@ -1,9 +1,15 @@
 #pragma once
+#include <new>
 #include <type_traits>
+#include <utility>
 #include "HashUtils.h"
 #include "HashDefines.h"
 #include "Buckets.h"
 #include "Container.h"
+#include "FreeList.h"
+#include "Magazines.h"
+#include "Epoch.h"
+#include "Arena.h"
 
 template <typename _Alloc>
 struct StaticSize
@@ -17,6 +23,11 @@ struct StaticSize
 	{
 		return KEY_COUNT;
 	}
+	//! \brief Key count is a power of two, so masking a hash selects a bucket
+	constexpr static uint32_t GetKeyMask() noexcept
+	{
+		return KEY_COUNT - 1;
+	}
 	constexpr static uint32_t GetMaxElements() noexcept
 	{
 		return MAX_ELEMENTS;
@@ -34,6 +45,7 @@ struct DynamicSize
 {
 	explicit DynamicSize(const uint32_t count) noexcept
 	    : keyCount(ComputeHashKeyCount(count))
+	    , keyMask(keyCount - 1)
 	    , maxElements(count)
 	{
 	}
@@ -42,12 +54,17 @@ struct DynamicSize
 	{
 		return keyCount;
 	}
+	inline uint32_t GetKeyMask() const noexcept
+	{
+		return keyMask;
+	}
 	inline uint32_t GetMaxElements() const noexcept
 	{
 		return maxElements;
 	}
 
 	const uint32_t keyCount;
+	const uint32_t keyMask;
 	const uint32_t maxElements;
 
 private:
@@ -58,6 +75,7 @@ struct DynamicSizeAllowInit
 {
 	inline DynamicSizeAllowInit() noexcept
 	    : keyCount(0)
+	    , keyMask(0)
 	    , maxElements(0)
 	    , isInitialized(false)
 	{
@@ -65,6 +83,7 @@ struct DynamicSizeAllowInit
 
 	inline explicit DynamicSizeAllowInit(const uint32_t max_elements) noexcept
 	    : keyCount(ComputeHashKeyCount(max_elements))
+	    , keyMask(keyCount - 1)
 	    , maxElements(max_elements)
 	    , isInitialized(true)
 	{
@@ -77,6 +96,7 @@ struct DynamicSizeAllowInit
 		{
 			maxElements = max_elements;
 			keyCount = ComputeHashKeyCount(GetMaxElements());
+			keyMask = keyCount - 1;
 			return true;
 		}
 		return false;
@@ -86,6 +106,10 @@ struct DynamicSizeAllowInit
 	{
 		return keyCount;
 	}
+	inline uint32_t GetKeyMask() const noexcept
+	{
+		return keyMask;
+	}
 	inline uint32_t GetMaxElements() const noexcept
 	{
 		return maxElements;
@@ -93,6 +117,7 @@ struct DynamicSizeAllowInit
 
 private:
 	uint32_t keyCount;
+	uint32_t keyMask;
 	uint32_t maxElements;
 	std::atomic<bool> isInitialized;
 
@@ -110,7 +135,13 @@ struct AllocationBase
 	                              DynamicSizeAllowInit>::type>::type Base;
 };
 
-template <typename K, typename V, typename _Alloc, bool MODE_INSERT_TAKE>
+template <typename K,
+          typename V,
+          typename _Alloc,
+          bool MODE_INSERT_TAKE,
+          bool MODE_ERASE,
+          bool MODE_UPDATE,
+          typename HashType>
 struct HashBaseNormal : public AllocationBase<_Alloc>::Base
 {
 protected:
@@ -120,25 +151,24 @@ protected:
 	              "!! LOGIC ERROR !! Collision bucket cannot be zero in this implementation");
 
 	typedef typename _Alloc::ALLOCATION_TYPE AT;
-	typedef KeyHashPairT<K> KeyHashPair;
+	typedef KeyHashPairT<K, HashType> KeyHashPair;
 
 	// Mode dependent typedefs
-	typedef
-	    typename std::conditional<MODE_INSERT_TAKE, KeyValueInsertTake<K, V>, KeyValueInsertRead<K, V>>::type KeyValue;
-
 	typedef typename std::conditional<MODE_INSERT_TAKE,
-	                                  BucketInsertTake<K, V, _Alloc::COLLISION_SIZE>,
-	                                  BucketInsertRead<K, V, _Alloc::COLLISION_SIZE>>::type Bucket;
+	                                  KeyValueInsertTake<K, V, true, HashType>,
+	                                  KeyValueInsertRead<K, V, HashType, MODE_UPDATE>>::type KeyValue;
+
+	typedef typename std::conditional<
+	    MODE_INSERT_TAKE,
+	    BucketInsertTake<K, V, _Alloc::COLLISION_SIZE, HashType>,
+	    BucketInsertRead<K, V, _Alloc::COLLISION_SIZE, HashType, MODE_UPDATE>>::type Bucket;
 
 	STATIC_ONLY(AT)
 	explicit HashBaseNormal() noexcept
 	    : m_recycle()
-	    , m_usedNodes(0)
+	    , m_epochs(m_freeList)
 	{
-		for (uint32_t i = 0; i < Base::GetMaxElements(); ++i)
-		{
-			m_recycle[i] = &m_keyStorage[i];
-		}
+		InitFreeList();
 	}
 
 	HEAP_ONLY(AT)
@@ -146,55 +176,99 @@ protected:
 	    : Base(max_elements)
 	    , m_keyStorage(max_elements)
 	    , m_recycle(max_elements)
-	    , m_usedNodes(0)
+	    , m_epochs(m_freeList)
 	{
-		for (uint32_t i = 0; i < max_elements; ++i)
-		{
-			m_recycle[i] = &m_keyStorage[i];
-		}
+		InitFreeList();
 	}
 
 	EXT_ONLY(AT)
 	HashBaseNormal() noexcept
-	    : m_usedNodes(0)
+	    : m_epochs(m_freeList)
+	{
+	}
+
+	//! \brief Links all nodes of the key storage in to the free-list
+	inline void InitFreeList() noexcept
 	{
+		m_freeList.Init(&m_keyStorage[0], &m_recycle[0], Base::GetMaxElements());
 	}
 
 	inline KeyValue* GetNextFreeKeyValue() noexcept
 	{
-		for (uint32_t i = m_usedNodes; i < Base::GetMaxElements(); ++i)
+		KeyValue* pKeyValue = m_magazines.Pop(m_freeList);
+		// Free nodes may still be waiting for their epoch to expire, the map is full only once none are. Pool is
+		// checked after every collect, since another thread may have collected the nodes meanwhile.
+		while (pKeyValue == nullptr)
 		{
-			KeyValue* pExpected = m_recycle[i];
-			if (pExpected == nullptr)
-				continue;
-			if (m_recycle[i].compare_exchange_strong(pExpected, nullptr))
-			{
-				m_usedNodes++;
-				return pExpected;
-			}
+			const uint32_t collected = m_epochs.CollectPending(Recycler());
+			pKeyValue = m_magazines.Pop(m_freeList);
+			if (collected == 0)
+				break;
 		}
-		return nullptr;
+		return pKeyValue;
 	}
 
-	void ReleaseNode(KeyValue* pKeyValue) noexcept
+	//! \brief Pins the epoch of the map for operations, which use nodes found in buckets
+	//! \details Nodes taken or erased while pinned are not recycled, before every operation pinned meanwhile has ended.
+	//!			 Maps, which neither take nor erase, never recycle published nodes, their guard is empty.
+	inline auto Pin() noexcept
 	{
-		for (uint32_t i = --m_usedNodes;; --i)
-		{
-			KeyValue* pNull = nullptr;
-			if (m_recycle[i].compare_exchange_strong(pNull, pKeyValue))
-			{
-				break;
-			}
+		return m_epochs.Pin();
+	}
 
-			if (i == 0)
-				break; // shouldn't get here
+	//! \brief Takes a free node, and sets its key to \p key of \p h and constructs its value from \p args
+	//! \details Pooled nodes are always constructed, so the old value is destroyed and the new one constructed in
+	//!			 its place. \p key and \p args are left untouched, if there is no free node.
+	//! \return The node, or nullptr if the map is full
+	template <typename _K, typename... Args>
+	inline KeyValue* CreateNode(const HashType h, _K&& key, Args&&... args) noexcept
+	{
+		KeyValue* pKeyValue = GetNextFreeKeyValue();
+		if (pKeyValue)
+		{
+			pKeyValue->v.~V();
+			new (&pKeyValue->v) V(std::forward<Args>(args)...);
+			pKeyValue->k = KeyHashPair::Make(h, std::forward<_K>(key));
 		}
+		return pKeyValue;
+	}
+
+	inline void ReleaseNode(KeyValue* pKeyValue) noexcept
+	{
+		// Other threads may still hold a taken node, which they found before it was taken
+		if constexpr (MODE_INSERT_TAKE)
+			m_epochs.Retire(pKeyValue, Recycler());
+		else
+			m_magazines.Push(m_freeList, pKeyValue);
+	}
+
+	//! \brief Returns chains of expired nodes to the magazine of the calling thread, the rest to the free-list
+	inline auto Recycler() noexcept
+	{
+		return [this](KeyValue* pFirst, KeyValue* pLast) { m_magazines.PushChain(m_freeList, pFirst, pLast); };
+	}
+
+	//! \brief Retires an erased node, which readers may still use, it's recycled once no pinned operation can use it
+	inline void RetireNode(KeyValue* pKeyValue) noexcept
+	{
+		m_epochs.Retire(pKeyValue, Recycler());
+	}
+
+	//! \brief Recycles the retired nodes of idle threads, which no pinned operation can use anymore
+	//! \return Number of nodes recycled
+	inline uint32_t ReclaimNodes() noexcept
+	{
+		return m_epochs.Collect(Recycler());
 	}
 
 	Container<KeyValue, _Alloc::ALLOCATOR, _Alloc::MAX_ELEMENTS> m_keyStorage;
+	// Links of the free-list, i.e. m_recycle[i] points to the node following m_keyStorage[i]
 	Container<std::atomic<KeyValue*>, _Alloc::ALLOCATOR, _Alloc::MAX_ELEMENTS> m_recycle;
 
-	std::atomic<uint32_t> m_usedNodes;
+	TaggedFreeList<KeyValue> m_freeList;
+	NodeMagazines<KeyValue, _Alloc::MAGAZINE_SIZE> m_magazines;
+	// Taken and erased nodes wait here for concurrent operations to end
+	EpochDomain<KeyValue, MODE_INSERT_TAKE || MODE_ERASE> m_epochs;
 
 	constexpr static const uint32_t _keys = sizeof(m_keyStorage);
 	constexpr static const uint32_t _recycle = sizeof(m_recycle);
@@ -203,59 +277,74 @@ private:
 	DISABLE_COPY_MOVE(HashBaseNormal)
 };
 
-template <typename K, typename V, typename _Alloc>
+template <typename K, typename V, typename _Alloc, typename HashType>
 struct BaseAllocateItemsFromHeap : public AllocationBase<_Alloc>::Base
 {
 protected:
 	typedef typename AllocationBase<_Alloc>::Base Base;
 	typedef typename _Alloc::ALLOCATION_TYPE AT;
-	typedef KeyHashPairT<K> KeyHashPair;
-	typedef KeyValueLinkedList<K, V> KeyValue;
-	typedef BucketLinkedList<K, V> Bucket;
+	typedef KeyHashPairT<K, HashType> KeyHashPair;
+	typedef KeyValueLinkedList<K, V, HashType> KeyValue;
+	typedef BucketLinkedList<K, V, HashType> Bucket;
 
 	STATIC_ONLY(AT)
 	BaseAllocateItemsFromHeap() noexcept
-	    : m_usedNodes(0)
 	{
 	}
 
 	HEAP_ONLY(AT)
 	explicit BaseAllocateItemsFromHeap(const uint32_t max_elements) noexcept
 	    : Base(max_elements)
-	    , m_usedNodes(0)
 	{
 	}
 
 	EXT_ONLY(AT)
 	BaseAllocateItemsFromHeap() noexcept
-	    : m_usedNodes(0)
 	{
 	}
 
 	inline KeyValue* GetNextFreeKeyValue() noexcept
 	{
-		m_usedNodes++;
-		return new (std::nothrow) KeyValue();
+		return m_arena.Allocate();
+	}
+
+	//! \brief Allocates a node, constructed with key \p key of \p h and a value constructed from \p args
+	//! \return The node, or nullptr if the arena is out of memory
+	template <typename _K, typename... Args>
+	inline KeyValue* CreateNode(const HashType h, _K&& key, Args&&... args) noexcept
+	{
+		return m_arena.Allocate(h, std::forward<_K>(key), std::forward<Args>(args)...);
+	}
+
+	//! \brief Nodes are never recycled, so there is nothing to pin
+	inline typename EpochDomain<KeyValue, false>::Guard Pin() noexcept
+	{
+		return {};
 	}
 
 	inline void ReleaseNode(KeyValue* pKeyValue) noexcept
 	{
-		m_usedNodes--;
-		delete pKeyValue;
+		// Node was never published, it's destroyed along with the arena
+		(void)pKeyValue;
 	}
 
 private:
-	std::atomic<uint32_t> m_usedNodes;
+	ChunkArena<KeyValue> m_arena;
 
 	DISABLE_COPY_MOVE(BaseAllocateItemsFromHeap)
 };
 
-template <typename K, typename V, typename _Alloc, MapMode OP_MODE>
+template <typename K, typename V, typename _Alloc, MapMode OP_MODE, typename HashType = uint32_t>
 struct BaseResolver
 {
 	typedef typename std::conditional<
 	    std::is_same<std::integral_constant<MapMode, OP_MODE>, MODE_INSERT_READ_HEAP_BUCKET>::value,
-	    BaseAllocateItemsFromHeap<K, V, _Alloc>,
-	    HashBaseNormal<K, V, _Alloc, std::is_same<std::integral_constant<MapMode, OP_MODE>, MODE_INSERT_TAKE>::value>>::
-	    type Base;
+	    BaseAllocateItemsFromHeap<K, V, _Alloc, HashType>,
+	    HashBaseNormal<K,
+	                   V,
+	                   _Alloc,
+	                   std::is_same<std::integral_constant<MapMode, OP_MODE>, MODE_INSERT_TAKE>::value,
+	                   std::is_same<std::integral_constant<MapMode, OP_MODE>, MODE_INSERT_READ_ERASE>::value,
+	                   std::is_same<std::integral_constant<MapMode, OP_MODE>, MODE_INSERT_READ_UPDATE>::value,
+	                   HashType>>::type Base;
 };
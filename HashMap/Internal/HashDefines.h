@@ -20,9 +20,32 @@
 #define MODE_NOT_TAKE(_MODE) \
 	template <typename _M = _MODE, typename std::enable_if<!std::is_same<_M, MODE_INSERT_TAKE>::value>::type* = nullptr>
 
+// Functions taking a receiver \p F, a callable with signature bool(const V&), which is inlined into the bucket scan
+#define IS_RECEIVER(F) std::is_invocable_r<bool, F&, const V&>::value
+
+#define MODE_TAKE_ONLY_RECEIVER(_MODE) \
+	template <typename F, \
+	          typename _M = _MODE, \
+	          typename std::enable_if<std::is_same<_M, MODE_INSERT_TAKE>::value && IS_RECEIVER(F)>::type* = nullptr>
+
+#define MODE_NOT_TAKE_RECEIVER(_MODE) \
+	template <typename F, \
+	          typename _M = _MODE, \
+	          typename std::enable_if<!std::is_same<_M, MODE_INSERT_TAKE>::value && IS_RECEIVER(F)>::type* = nullptr>
+
+#define MODE_ERASE_ONLY(_MODE) \
+	template <typename _M = _MODE, \
+	          typename std::enable_if<std::is_same<_M, MODE_INSERT_READ_ERASE>::value>::type* = nullptr>
+
+#define MODE_UPDATE_ONLY(_MODE) \
+	template <typename _M = _MODE, \
+	          typename std::enable_if<std::is_same<_M, MODE_INSERT_READ_UPDATE>::value>::type* = nullptr>
+
 #define IS_INSERT_TAKE(x) std::is_same<std::integral_constant<MapMode, x>, MODE_INSERT_TAKE>::value
 #define IS_INSERT_READ_FROM_HEAP(x) \
 	std::is_same<std::integral_constant<MapMode, x>, MODE_INSERT_READ_HEAP_BUCKET>::value
+#define IS_INSERT_READ_ERASE(x) std::is_same<std::integral_constant<MapMode, x>, MODE_INSERT_READ_ERASE>::value
+#define IS_INSERT_READ_UPDATE(x) std::is_same<std::integral_constant<MapMode, x>, MODE_INSERT_READ_UPDATE>::value
 
 #define HEAP_ONLY_IMPL \
 	template <typename AT, typename std::enable_if<std::is_same<AT, ALLOCATION_TYPE_HEAP>::value>::type*>
@@ -37,6 +60,22 @@
 #define MODE_NOT_TAKE_IMPL \
 	template <typename _M, typename std::enable_if<!std::is_same<_M, MODE_INSERT_TAKE>::value>::type*>
 
+#define MODE_TAKE_ONLY_RECEIVER_IMPL \
+	template <typename F, \
+	          typename _M, \
+	          typename std::enable_if<std::is_same<_M, MODE_INSERT_TAKE>::value && IS_RECEIVER(F)>::type*>
+
+#define MODE_NOT_TAKE_RECEIVER_IMPL \
+	template <typename F, \
+	          typename _M, \
+	          typename std::enable_if<!std::is_same<_M, MODE_INSERT_TAKE>::value && IS_RECEIVER(F)>::type*>
+
+#define MODE_ERASE_ONLY_IMPL \
+	template <typename _M, typename std::enable_if<std::is_same<_M, MODE_INSERT_READ_ERASE>::value>::type*>
+
+#define MODE_UPDATE_ONLY_IMPL \
+	template <typename _M, typename std::enable_if<std::is_same<_M, MODE_INSERT_READ_UPDATE>::value>::type*>
+
 #define DISABLE_COPY_MOVE(_class) \
 	inline _class& operator=(const _class&) noexcept = delete; \
 	inline _class& operator=(const _class&&) noexcept = delete; \
@@ -46,6 +85,79 @@
 // Number of slots in a single bucket
 const uint32_t DEFAULT_COLLISION_SIZE = 16;
 
+// Distance of the farthest following bucket an item of a full bucket may overflow to, the overflow hint of a
+// MapMode::PARALLEL_INSERT_TAKE bucket counts its updates in the bits above the distance
+const uint32_t OVERFLOW_MAX_DISTANCE = 0xFFFF;
+
+// Number of per-thread node magazines in a map (threads are mapped to magazines in round-robin)
+const uint32_t MAGAZINE_SLOTS = 64;
+
+// Number of times a thread, which found the free-list empty, retries to lock a busy magazine to steal from
+const uint32_t MAGAZINE_STEAL_SPINS = 256;
+
+// Number of epoch records held by a MapMode::PARALLEL_INSERT_TAKE or PARALLEL_INSERT_READ_ERASE map, further threads
+// register records allocated from the heap in chunks of this size (see EpochDomain)
+const uint32_t EPOCH_SLOTS = 64;
+
+// Number of epoch domains a thread keeps its records of in a thread-local table, records of further domains are
+// registered by each outermost pin and released when it ends
+const uint32_t EPOCH_THREAD_DOMAINS = 16;
+
+// Number of nodes a thread retires, before it tries to advance the epoch and recycle expired nodes
+const uint32_t EPOCH_BATCH = 64;
+
+// Number of times a map, which has run out of free nodes, tries to collect nodes of expired epochs
+const uint32_t EPOCH_COLLECT_ATTEMPTS = 64;
+
+// Number of nodes in a single heap allocated chunk in MapMode::PARALLEL_INSERT_READ_GROW_FROM_HEAP
+const uint32_t ARENA_CHUNK_SIZE = 256;
+
+// Number of chunks nodes are concurrently allocated from (threads are mapped to chunks in round-robin)
+const uint32_t ARENA_SLOTS = 16;
+
+// Size of a cache line, used to keep per-thread data apart
+const uint32_t CACHE_LINE_SIZE = 64;
+
+// Number of keys ReadMany and TakeMany hash and prefetch ahead, before looking any of them up
+const uint32_t LOOKUP_BATCH_SIZE = 16;
+
+// Number of lookups an InterleavedLookup keeps in flight
+const uint32_t INTERLEAVED_LOOKUPS = 8;
+
+// Minimum number of records Hash::BulkLoad hashes and partitions in one work item
+const uint32_t BULK_LOAD_MIN_CHUNK_SIZE = 1 << 16;
+
+// Number of buckets a thread of Hash::ParallelForEach or Hash::DrainAll claims at a time
+const uint32_t FOR_EACH_CHUNK_BUCKETS = 256;
+
+// Number of buckets Hash::BulkLoad fills as one partition, small enough to stay in the cache while filled
+const uint32_t BULK_LOAD_PARTITION_BUCKETS = 1024;
+
+// Maximum number of partitions of Hash::BulkLoad
+const uint32_t BULK_LOAD_MAX_PARTITIONS = 1 << 16;
+
+// Number of locks serializing adds of absent keys by Hash::Upsert, Update and FetchAdd
+const uint32_t UPSERT_LOCK_STRIPES = 64;
+
+// Maximum number of generations of a GrowableHash, each generation doubles the capacity of the previous one
+const uint32_t GROWABLE_MAX_GENERATIONS = 24;
+
+// Maximum capacity of a single GrowableHash generation
+const uint32_t GROWABLE_MAX_ELEMENTS = 1U << 30;
+
+// Number of counters the adders of a GrowableHash generation are spread over
+const uint32_t GROWABLE_ADDER_SLOTS = 16;
+
+// Number of buckets a single call checks, when retiring drained GrowableHash generations in take mode
+const uint32_t GROWABLE_RETIRE_STEP = 64;
+
+// Number of buckets a single call copies to the newest GrowableHash generation in read modes
+const uint32_t GROWABLE_COPY_STEP = 8;
+
+// Longest sleep of a waiter with a timeout between two checks of the sequence word it waits on, in microseconds,
+// on platforms which can't park a thread on a word with a timeout (other than Windows and Linux)
+const uint32_t WAIT_MAX_SLEEP_US = 1000;
+
 enum class AllocatorType
 {
 	STATIC,
@@ -77,7 +189,42 @@ enum class MapMode
 	//	* Inserting items
 	//	* Reading items with Value functions (i.e. read item is not removed from map)
 	//! \constrains Once an item is inserted into the map, it cannot be removed. Key must fulfill std::is_default_constructible
-	PARALLEL_INSERT_READ_GROW_FROM_HEAP = 0b100
+	PARALLEL_INSERT_READ_GROW_FROM_HEAP = 0b100,
+
+	//! \brief	PARALLEL_INSERT_READ, whose items can also be erased
+	//! \Note	Reads pin the epoch of the map, so that nodes of erased items are recycled only once no read can use
+	//!			them anymore. Maps, which never erase, should use PARALLEL_INSERT_READ, whose reads don't pin.
+	// \details Hash supports following lock-free operations in parallel:
+	//	* Inserting items
+	//	* Reading items with Value functions (i.e. read item is not removed from map)
+	//	* Erasing items
+	//! \constrains Key must fulfill std::is_default_constructible
+	PARALLEL_INSERT_READ_ERASE = 0b1000,
+
+	//! \brief	PARALLEL_INSERT_READ, whose values can also be updated in place with Upsert, Update and FetchAdd
+	//! \Note	Nodes of trivially copyable values, which are not atomic, carry a seqlock, which reads check, so that they
+	//!			never see a torn value. Maps, which never update, should use PARALLEL_INSERT_READ, whose reads copy
+	//!			values without the seqlock.
+	// \details Hash supports following lock-free operations in parallel:
+	//	* Inserting items
+	//	* Reading items with Value functions (i.e. read item is not removed from map)
+	//	* Updating values of existing items (adds of absent keys are serialized by striped locks)
+	//! \constrains Once an item is inserted into the map, it cannot be removed. Key must fulfill std::is_default_constructible
+	PARALLEL_INSERT_READ_UPDATE = 0b10000
+};
+
+//! \brief Selects the bucket(s) an item can be placed in
+enum class BucketPlacement
+{
+	//! \brief Item is placed in the bucket selected by its hash
+	SINGLE,
+
+	//! \brief Item has two candidate buckets selected by independent bits of its hash ("power of two choices")
+	//!			and is placed in the one holding fewer items, lookups check both candidates
+	//! \details	Maximum bucket occupancy is much lower than with SINGLE, so a smaller bucket size is enough
+	//!			for the same fill ratio, at the cost of checking a second bucket on misses
+	//! \constrains Not supported in PARALLEL_INSERT_READ_GROW_FROM_HEAP mode (buckets have no fixed size)
+	TWO_CHOICE
 };
 
 //! \brief
@@ -89,6 +236,12 @@ typedef std::integral_constant<MapMode, MapMode::PARALLEL_INSERT_READ> MODE_INSE
 //! \brief Special case of PARALLEL_INSERT_READ
 typedef std::integral_constant<MapMode, MapMode::PARALLEL_INSERT_READ_GROW_FROM_HEAP> MODE_INSERT_READ_HEAP_BUCKET;
 
+//! \brief PARALLEL_INSERT_READ with removal
+typedef std::integral_constant<MapMode, MapMode::PARALLEL_INSERT_READ_ERASE> MODE_INSERT_READ_ERASE;
+
+//! \brief PARALLEL_INSERT_READ with in-place updates
+typedef std::integral_constant<MapMode, MapMode::PARALLEL_INSERT_READ_UPDATE> MODE_INSERT_READ_UPDATE;
+
 //! \brief Allocate memory from heap
 typedef std::integral_constant<AllocatorType, AllocatorType::HEAP> ALLOCATION_TYPE_HEAP;
 
@@ -1,49 +1,144 @@
 #pragma once
 #include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Constants of the hash functions below, from xxHash and MurmurHash3
+constexpr const uint64_t HASH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr const uint64_t HASH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr const uint64_t HASH_PRIME64_3 = 0x165667B19E3779F9ULL;
+
+//! \brief Scrambles all bits of a 32-bit value (MurmurHash3 finalizer), every input bit affects every output bit
+constexpr inline uint32_t MixBits(uint32_t h) noexcept
+{
+	h ^= h >> 16;
+	h *= 0x85EBCA6BU;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35U;
+	h ^= h >> 16;
+	return h;
+}
+
+//! \brief Scrambles all bits of a 64-bit value (MurmurHash3 finalizer)
+constexpr inline uint64_t MixBits(uint64_t h) noexcept
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+constexpr inline uint64_t RotateLeft(const uint64_t value, const uint32_t bits) noexcept
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+//! \brief Hashes \p length bytes from \p pData to 64 bits
+//! \details Input is consumed a word at a time in two independent lanes (xxHash64 rounds), so the loop runs at
+//!			 roughly 16 bytes per multiply latency. The lanes are combined and finalized with MixBits.
+inline uint64_t HashBytes64(const void* pData, size_t length, const uint64_t seed = 0) noexcept
+{
+	const auto Round = [](const uint64_t acc, const uint64_t input) noexcept {
+		return RotateLeft(acc + input * HASH_PRIME64_2, 31) * HASH_PRIME64_1;
+	};
+	const auto Load = [](const unsigned char* pBytes) noexcept {
+		uint64_t word;
+		memcpy(&word, pBytes, sizeof(word));
+		return word;
+	};
+
+	const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+	uint64_t a = seed + HASH_PRIME64_1;
+	uint64_t b = (uint64_t(length) ^ seed) + HASH_PRIME64_3;
+	for (; length >= 16; length -= 16, pBytes += 16)
+	{
+		a = Round(a, Load(pBytes));
+		b = Round(b, Load(pBytes + 8));
+	}
+	if (length >= 8)
+	{
+		a = Round(a, Load(pBytes));
+		length -= 8;
+		pBytes += 8;
+	}
+	if (length > 0)
+	{
+		uint64_t tail = 0;
+		memcpy(&tail, pBytes, length);
+		b = Round(b, tail);
+	}
+	return MixBits(RotateLeft(a, 1) + RotateLeft(b, 7));
+}
+
+//! \brief Hashes \p length bytes from \p pData, see HashBytes64
+inline uint32_t HashBytes(const void* pData, size_t length, const uint32_t seed = 0) noexcept
+{
+	const uint64_t h = HashBytes64(pData, length, seed);
+	return uint32_t(h ^ (h >> 32));
+}
 
 constexpr inline uint32_t hash(char key, uint32_t seed = 0) noexcept
 {
-	return uint32_t(key) ^ seed;
+	return MixBits(uint32_t(key) ^ seed);
 }
 constexpr inline uint32_t hash(unsigned char key, uint32_t seed = 0) noexcept
 {
-	return uint32_t(key) ^ seed;
+	return MixBits(uint32_t(key) ^ seed);
 }
 constexpr inline uint32_t hash(signed char key, uint32_t seed = 0) noexcept
 {
-	return uint32_t(key) ^ seed;
+	return MixBits(uint32_t(key) ^ seed);
 }
 constexpr inline uint32_t hash(unsigned short key, uint32_t seed = 0) noexcept
 {
-	return uint32_t(key) ^ seed;
+	return MixBits(uint32_t(key) ^ seed);
 }
 constexpr inline uint32_t hash(short key, uint32_t seed = 0) noexcept
 {
-	return uint32_t(key) ^ seed;
+	return MixBits(uint32_t(key) ^ seed);
 }
 constexpr inline uint32_t hash(unsigned int key, uint32_t seed = 0) noexcept
 {
-	return key ^ seed;
+	return MixBits(key ^ seed);
 }
 constexpr inline uint32_t hash(int key, uint32_t seed = 0) noexcept
 {
-	return uint32_t(key) ^ seed;
+	return MixBits(uint32_t(key) ^ seed);
 }
 constexpr inline uint32_t hash(uint64_t key, uint32_t seed = 0) noexcept
 {
-	if constexpr (sizeof(uint32_t) >= sizeof(uint64_t))
-	{
-		return key ^ seed;
-	}
-	return uint32_t(((key >> (8 * sizeof(uint32_t) - 1)) ^ key) & (~0U)) ^ seed;
+	const uint64_t h = MixBits(key ^ seed);
+	return uint32_t(h ^ (h >> 32));
 }
 constexpr inline uint32_t hash(int64_t key, uint32_t seed = 0) noexcept
 {
 	return hash(uint64_t(key), seed);
 }
+inline uint32_t hash(const std::string_view& key, uint32_t seed = 0) noexcept
+{
+	return HashBytes(key.data(), key.size(), seed);
+}
+inline uint32_t hash(const std::string& key, uint32_t seed = 0) noexcept
+{
+	return HashBytes(key.data(), key.size(), seed);
+}
+
+//! \brief Hash of a type, whose equal values have equal bytes (e.g. plain structs of integers without padding)
+template <typename T,
+          typename std::enable_if<std::has_unique_object_representations<T>::value
+                                  && !std::is_integral<T>::value>::type* = nullptr>
+inline uint32_t hash(const T& t, uint32_t seed = 0) noexcept
+{
+	return HashBytes(&t, sizeof(T), seed);
+}
 
-template <typename T>
+//! \brief Hash of other types, which provide a hash(const T&) overload
+template <typename T, typename std::enable_if<!std::has_unique_object_representations<T>::value>::type* = nullptr>
 inline uint32_t hash(const T& t, uint32_t seed) noexcept(noexcept(hash(t)))
 {
-	return hash(t) ^ seed;
+	return MixBits(hash(t) ^ seed);
 };
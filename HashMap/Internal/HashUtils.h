@@ -7,11 +7,14 @@
 #include "Container.h"
 #include "Debug.h"
 
-template <AllocatorType TYPE>
+template <AllocatorType TYPE, uint32_t NODE_MAGAZINE_SIZE = 0>
 struct Allocator
 {
 	constexpr static const std::integral_constant<AllocatorType, TYPE> ALLOCATOR{};
 	typedef std::integral_constant<AllocatorType, TYPE> ALLOCATION_TYPE;
+
+	// Size of the per-thread node caches, zero disables them
+	constexpr static const uint32_t MAGAZINE_SIZE = NODE_MAGAZINE_SIZE;
 };
 
 template <uint32_t COLLISION_SIZE, uint32_t MAX_ELEMENTS = 0, uint32_t KEY_COUNT = 0>
@@ -40,7 +43,7 @@ struct GeneralKeyReqs
 	}
 };
 
-template <typename K, bool CHECK_FOR_ATOMIC_ACCESS>
+template <typename K, bool CHECK_FOR_ATOMIC_ACCESS, typename HashType = uint32_t>
 struct AtomicsRequired
 {
 	static constexpr const GeneralKeyReqs<K> GENERAL_REQS{};
@@ -54,7 +57,7 @@ struct AtomicsRequired
 
 	constexpr static const bool STD_ATOMIC_ALWAYS_LOCK_FREE = []() {
 		if constexpr (STD_ATOMIC_REQS_MET::value)
-			return std::atomic<K>::is_always_lock_free && std::atomic<KeyHashPairT<K>>::is_always_lock_free;
+			return std::atomic<K>::is_always_lock_free && std::atomic<KeyHashPairT<K, HashType>>::is_always_lock_free;
 		return false;
 	}();
 
@@ -107,16 +110,16 @@ struct AtomicsRequired
 	}
 };
 
-template <typename K, MapMode OP_MODE>
+template <typename K, MapMode OP_MODE, typename HashType = uint32_t>
 struct HashKeyProperties
     : public std::conditional<std::is_same<std::integral_constant<MapMode, OP_MODE>, MODE_INSERT_TAKE>::value,
-                              AtomicsRequired<K, true>,
+                              AtomicsRequired<K, true, HashType>,
                               GeneralKeyReqs<K>>::type
 {
 	typedef typename std::integral_constant<MapMode, OP_MODE> MODE;
 
 	typedef typename std::conditional<std::is_same<std::integral_constant<MapMode, OP_MODE>, MODE_INSERT_TAKE>::value,
-	                                  AtomicsRequired<K, true>,
+	                                  AtomicsRequired<K, true, HashType>,
 	                                  GeneralKeyReqs<K>>::type Base;
 
 	constexpr static const bool VALID_KEY_TYPE = Base::VALID_KEY_TYPE;
@@ -132,10 +135,10 @@ struct HashKeyProperties
 	}
 };
 
-template <typename K, MapMode OP_MODE>
-struct KeyPropertyValidator : public HashKeyProperties<K, OP_MODE>
+template <typename K, MapMode OP_MODE, typename HashType = uint32_t>
+struct KeyPropertyValidator : public HashKeyProperties<K, OP_MODE, HashType>
 {
-	typedef typename HashKeyProperties<K, OP_MODE> KeyProps;
+	typedef typename HashKeyProperties<K, OP_MODE, HashType> KeyProps;
 	static_assert(KeyProps::AssertAll(), "Hash key failed to meet requirements");
 };
 
@@ -157,3 +160,37 @@ struct DefaultModeSelector
 	                                                     // MODE_INSERT_TAKE or MODE_INSERT_TAKE>
 	    ::value; // Extract actual type from selected mode
 };
+
+//! \brief Striped locks serializing adds of absent keys by Hash::Upsert, Update and FetchAdd
+template <bool ENABLED>
+class UpsertLocks
+{
+public:
+	inline UpsertLocks() noexcept
+	{
+	}
+
+	//! \brief Returns the lock of the stripe of \p hash
+	template <typename HashType>
+	inline std::mutex& operator[](const HashType hash) noexcept
+	{
+		return m_locks[uint32_t(hash) % UPSERT_LOCK_STRIPES];
+	}
+
+private:
+	std::mutex m_locks[UPSERT_LOCK_STRIPES];
+
+	DISABLE_COPY_MOVE(UpsertLocks)
+};
+
+//! \brief No locks, for maps whose values are never updated in place
+template <>
+class UpsertLocks<false>
+{
+public:
+	inline UpsertLocks() noexcept
+	{
+	}
+
+	DISABLE_COPY_MOVE(UpsertLocks)
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "HashFunctions.h"
+#include "UtilityFunctions.h"
+
+// Hash policies for the _Hasher parameter of Hash.
+// A hasher is constructed from the seed of the map and maps a key to a 32-bit or a 64-bit hash with a noexcept
+// operator(), the return type selects the width of the hashes stored in the map.
+// Buckets are selected by the low bits of the hash and fingerprints are taken from the high bits, so both ends
+// of the hash must be well mixed.
+
+//! \brief Type of the hashes \p _Hasher computes for keys of type \p K
+template <typename K, typename _Hasher>
+using HashTypeOf = std::decay_t<decltype(std::declval<const _Hasher&>()(std::declval<const K&>()))>;
+
+//! \brief Hash of a key together with the seed it was computed with, see Hash::ComputeHash
+//! \details Lets the hash of a key be computed once and reused over several operations, or be supplied by an
+//!			 upstream stage which uses the same hasher and seed as the map.
+template <typename HashType>
+struct HashedKeyT
+{
+	HashType hash;
+	uint32_t seed;
+};
+
+//! \brief Hashes keys with the hash(const K&, uint32_t) functions, see HashFunctions.h
+//! \tparam HashType	uint32_t or uint64_t. 64-bit hashes keep the bucket index and the fingerprint in separate bits
+//!					of the hash even in tables of more than 2^24 buckets, and let the full hash comparison reject
+//!					more non-matching keys, at the cost of larger nodes.
+template <typename K, typename HashType = uint32_t>
+struct DefaultHasher
+{
+	static_assert(std::is_same<HashType, uint32_t>::value || std::is_same<HashType, uint64_t>::value,
+	              "Hash must be uint32_t or uint64_t");
+
+	inline explicit DefaultHasher(const uint32_t seed) noexcept
+	    : m_seed(seed)
+	{
+	}
+
+	inline HashType operator()(const K& k) const noexcept
+	{
+		if constexpr (std::is_same<HashType, uint32_t>::value)
+		{
+			return hash(k, m_seed);
+		}
+		else if constexpr (std::is_integral<K>::value || std::is_enum<K>::value)
+		{
+			return MixBits(uint64_t(k) ^ (m_seed * HASH_PRIME64_1));
+		}
+		else if constexpr (std::is_same<K, std::string>::value || std::is_same<K, std::string_view>::value)
+		{
+			return HashBytes64(k.data(), k.size(), m_seed);
+		}
+		else if constexpr (std::has_unique_object_representations<K>::value)
+		{
+			return HashBytes64(&k, sizeof(K), m_seed);
+		}
+		else
+		{
+			// Only 32 bits of entropy, but spread over the whole width
+			const uint64_t h = hash(k, m_seed);
+			return MixBits(h | (h << 32));
+		}
+	}
+
+private:
+	uint32_t m_seed;
+};
+
+//! \brief Single multiplication (Fibonacci hashing) for trusted integer keys in hot maps
+//! \details Cheapest hash with usable bucket distribution, but trivially predictable: never use it for keys,
+//!			 which can be chosen by an adversary.
+template <typename K>
+struct MultiplicativeHasher
+{
+	static_assert(std::is_integral<K>::value || std::is_enum<K>::value,
+	              "MultiplicativeHasher supports only integer and enum keys");
+
+	inline explicit MultiplicativeHasher(const uint32_t seed) noexcept
+	    : m_seed(seed)
+	{
+	}
+
+	inline uint32_t operator()(const K& k) const noexcept
+	{
+		// Upper half of the product depends on all key bits
+		return uint32_t(((uint64_t(k) ^ m_seed) * HASH_PRIME64_1) >> 32);
+	}
+
+private:
+	uint64_t m_seed;
+};
+
+//! \brief SipHash-1-3 over 64-bit words, keyed with \p k0 and \p k1
+inline uint64_t SipHash13(const void* pData, size_t length, const uint64_t k0, const uint64_t k1) noexcept
+{
+	uint64_t v0 = k0 ^ 0x736F6D6570736575ULL;
+	uint64_t v1 = k1 ^ 0x646F72616E646F6DULL;
+	uint64_t v2 = k0 ^ 0x6C7967656E657261ULL;
+	uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+	const auto Round = [&]() noexcept {
+		v0 += v1;
+		v1 = RotateLeft(v1, 13);
+		v1 ^= v0;
+		v0 = RotateLeft(v0, 32);
+		v2 += v3;
+		v3 = RotateLeft(v3, 16);
+		v3 ^= v2;
+		v0 += v3;
+		v3 = RotateLeft(v3, 21);
+		v3 ^= v0;
+		v2 += v1;
+		v1 = RotateLeft(v1, 17);
+		v1 ^= v2;
+		v2 = RotateLeft(v2, 32);
+	};
+
+	const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+	const uint64_t last = uint64_t(length) << 56;
+	for (; length >= 8; length -= 8, pBytes += 8)
+	{
+		uint64_t m;
+		memcpy(&m, pBytes, sizeof(m));
+		v3 ^= m;
+		Round();
+		v0 ^= m;
+	}
+	uint64_t tail = 0;
+	memcpy(&tail, pBytes, length);
+	const uint64_t m = last | tail;
+	v3 ^= m;
+	Round();
+	v0 ^= m;
+
+	v2 ^= 0xFF;
+	Round();
+	Round();
+	Round();
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+//! \brief Keyed hash (SipHash-1-3) for keys supplied from outside, resists hash flooding
+//! \details The key of SipHash combines the seed of the map with a random secret, which is generated once per
+//!			 process, so hashes cannot be predicted even if the seed is known.
+//! \constrains Key must be std::string, std::string_view or have unique object representations
+//! \tparam HashType	uint32_t or uint64_t, see DefaultHasher
+template <typename K, typename HashType = uint32_t>
+struct SipHasher
+{
+	static_assert(std::has_unique_object_representations<K>::value || std::is_same<K, std::string>::value
+	                  || std::is_same<K, std::string_view>::value,
+	              "SipHasher supports strings and types with unique object representations");
+	static_assert(std::is_same<HashType, uint32_t>::value || std::is_same<HashType, uint64_t>::value,
+	              "Hash must be uint32_t or uint64_t");
+
+	inline explicit SipHasher(const uint32_t seed) noexcept
+	    : m_k0(GetProcessSecret()[0] ^ seed)
+	    , m_k1(GetProcessSecret()[1] ^ MixBits(uint64_t(seed)))
+	{
+	}
+
+	inline HashType operator()(const K& k) const noexcept
+	{
+		uint64_t h;
+		if constexpr (std::is_same<K, std::string>::value || std::is_same<K, std::string_view>::value)
+			h = SipHash13(k.data(), k.size(), m_k0, m_k1);
+		else
+			h = SipHash13(&k, sizeof(K), m_k0, m_k1);
+		if constexpr (std::is_same<HashType, uint64_t>::value)
+			return h;
+		else
+			return uint32_t(h ^ (h >> 32));
+	}
+
+private:
+	inline static const uint64_t* GetProcessSecret() noexcept
+	{
+		static const uint64_t secret[2] = {(uint64_t(GenerateSeed()) << 32) | GenerateSeed(),
+		                                   (uint64_t(GenerateSeed()) << 32) | GenerateSeed()};
+		return secret;
+	}
+
+private:
+	uint64_t m_k0;
+	uint64_t m_k1;
+};
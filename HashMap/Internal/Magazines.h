@@ -0,0 +1,168 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include "HashDefines.h"
+#include "FreeList.h"
+#include "UtilityFunctions.h"
+
+//! \brief Per-thread caches ("magazines") of free nodes in front of the shared free-list
+//! \details Each thread is mapped to one of MAGAZINE_SLOTS magazines. Nodes are moved between a magazine
+//!			 and the shared free-list in batches of MAGAZINE_SIZE / 2, so most acquire/release operations
+//!			 touch only the cache line of the calling thread's magazine.
+//!			 Hoarding is bounded: a magazine never holds more than MAGAZINE_SIZE nodes, and once the shared
+//!			 free-list runs dry, nodes are stolen from other magazines before reporting the map full.
+//!			 A magazine is owned with a try-lock; if it is busy (another thread mapped to the same slot),
+//!			 the shared free-list is used directly. Only a thread stealing from a busy magazine retries the lock
+//!			 for a bounded number of spins, since the map must not be reported full while it holds free nodes.
+template <typename T, uint32_t MAGAZINE_SIZE>
+class NodeMagazines
+{
+	constexpr static const uint32_t BATCH_SIZE = (MAGAZINE_SIZE / 2) > 0 ? (MAGAZINE_SIZE / 2) : 1;
+
+	struct alignas(CACHE_LINE_SIZE) Magazine
+	{
+		std::atomic<bool> inUse;
+		uint32_t count;
+		T* items[MAGAZINE_SIZE];
+	};
+
+public:
+	inline NodeMagazines() noexcept
+	{
+		for (uint32_t i = 0; i < MAGAZINE_SLOTS; ++i)
+		{
+			m_magazines[i].inUse = false;
+			m_magazines[i].count = 0;
+		}
+	}
+
+	//! \brief Acquires a free node, from the calling thread's magazine if possible
+	//! \return Free node, or nullptr if all nodes are in use
+	inline T* Pop(TaggedFreeList<T>& freeList) noexcept
+	{
+		T* pItem = nullptr;
+		Magazine& magazine = m_magazines[GetThreadSlot() % MAGAZINE_SLOTS];
+		if (TryLock(magazine))
+		{
+			if (magazine.count == 0)
+				magazine.count = freeList.PopBatch(magazine.items, BATCH_SIZE);
+			if (magazine.count > 0)
+				pItem = magazine.items[--magazine.count];
+			Unlock(magazine);
+		}
+
+		if (pItem == nullptr)
+			pItem = freeList.Pop();
+		if (pItem == nullptr)
+			pItem = Steal();
+		return pItem;
+	}
+
+	//! \brief Releases a node, in to the calling thread's magazine if possible
+	inline void Push(TaggedFreeList<T>& freeList, T* pItem) noexcept
+	{
+		Magazine& magazine = m_magazines[GetThreadSlot() % MAGAZINE_SLOTS];
+		if (TryLock(magazine))
+		{
+			if (magazine.count == MAGAZINE_SIZE)
+			{
+				// Magazine is full, hand the upper half back to the shared free-list
+				magazine.count -= BATCH_SIZE;
+				freeList.PushBatch(&magazine.items[magazine.count], BATCH_SIZE);
+			}
+			magazine.items[magazine.count++] = pItem;
+			Unlock(magazine);
+		}
+		else
+		{
+			freeList.Push(pItem);
+		}
+	}
+
+	//! \brief Releases a chain of nodes from \p pFirst to \p pLast, linked in \p freeList, filling the calling thread's
+	//!		   magazine first
+	inline void PushChain(TaggedFreeList<T>& freeList, T* pFirst, T* pLast) noexcept
+	{
+		Magazine& magazine = m_magazines[GetThreadSlot() % MAGAZINE_SLOTS];
+		if (TryLock(magazine))
+		{
+			while (pFirst && magazine.count < MAGAZINE_SIZE)
+			{
+				T* pNext = (pFirst != pLast) ? freeList.Next(pFirst) : nullptr;
+				magazine.items[magazine.count++] = pFirst;
+				pFirst = pNext;
+			}
+			Unlock(magazine);
+		}
+
+		if (pFirst)
+			freeList.PushChain(pFirst, pLast);
+	}
+
+private:
+	inline T* Steal() noexcept
+	{
+		for (uint32_t i = 0; i < MAGAZINE_SLOTS; ++i)
+		{
+			Magazine& magazine = m_magazines[i];
+			// Owner holds the lock only for a few instructions
+			bool locked = TryLock(magazine);
+			for (uint32_t spin = 0; !locked && spin < MAGAZINE_STEAL_SPINS; ++spin)
+			{
+				CpuRelax();
+				locked = TryLock(magazine);
+			}
+			if (!locked)
+				continue;
+
+			T* pItem = (magazine.count > 0) ? magazine.items[--magazine.count] : nullptr;
+			Unlock(magazine);
+			if (pItem)
+				return pItem;
+		}
+		return nullptr;
+	}
+
+	inline static bool TryLock(Magazine& magazine) noexcept
+	{
+		return !magazine.inUse.load(std::memory_order_relaxed)
+		       && !magazine.inUse.exchange(true, std::memory_order_acquire);
+	}
+
+	inline static void Unlock(Magazine& magazine) noexcept
+	{
+		magazine.inUse.store(false, std::memory_order_release);
+	}
+
+private:
+	Magazine m_magazines[MAGAZINE_SLOTS];
+
+	DISABLE_COPY_MOVE(NodeMagazines)
+};
+
+//! \brief Magazines disabled, nodes are taken directly from the shared free-list
+template <typename T>
+class NodeMagazines<T, 0>
+{
+public:
+	inline NodeMagazines() noexcept
+	{
+	}
+
+	inline T* Pop(TaggedFreeList<T>& freeList) noexcept
+	{
+		return freeList.Pop();
+	}
+
+	inline void Push(TaggedFreeList<T>& freeList, T* pItem) noexcept
+	{
+		freeList.Push(pItem);
+	}
+
+	inline void PushChain(TaggedFreeList<T>& freeList, T* pFirst, T* pLast) noexcept
+	{
+		freeList.PushChain(pFirst, pLast);
+	}
+
+	DISABLE_COPY_MOVE(NodeMagazines)
+};
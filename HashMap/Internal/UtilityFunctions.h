@@ -1,6 +1,29 @@
 #pragma once
 #include <type_traits>
 #include <random>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib") // WaitOnAddress, WakeByAddressAll
+#elif defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include "HashDefines.h"
 
 static uint32_t GenerateSeed() noexcept
@@ -29,3 +52,183 @@ constexpr static uint32_t ComputeHashKeyCount(const uint32_t count) noexcept
 {
 	return GetNextPowerOfTwo(count * 2);
 }
+
+//! \brief Returns a small number identifying the calling thread, threads are numbered in order of first call
+inline uint32_t GetThreadSlot() noexcept
+{
+	static std::atomic<uint32_t> threads{0};
+	thread_local const uint32_t slot = threads++;
+	return slot;
+}
+
+//! \brief Calls \p f(i) for each i in [0, \p count) on the calling thread and on \p threads - 1 additional threads
+//! \details Items are claimed one at a time, so threads, which fail to start, only reduce the parallelism
+template <typename F>
+inline void ParallelFor(const uint32_t threads, const size_t count, F&& f) noexcept
+{
+	std::atomic<size_t> next{0};
+	const auto work = [&]() noexcept {
+		for (size_t i = next++; i < count; i = next++)
+			f(i);
+	};
+
+	std::vector<std::thread> workers;
+	try
+	{
+		workers.reserve(threads);
+		for (uint32_t t = 1; t < threads && t < count; ++t)
+			workers.emplace_back(work);
+	}
+	catch (...)
+	{
+		// Continue with the threads started so far
+	}
+	work();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+//! \brief Returns the index of the lowest set bit, \p value must not be zero
+inline uint32_t CountTrailingZeros(const uint64_t value) noexcept
+{
+#if defined(_M_X64) || defined(_M_ARM64)
+	unsigned long index = 0;
+	_BitScanForward64(&index, value);
+	return uint32_t(index);
+#elif defined(_MSC_VER)
+	// 32-bit targets have no 64-bit bit scan, the halves are scanned separately
+	unsigned long index = 0;
+	if (_BitScanForward(&index, uint32_t(value)))
+		return uint32_t(index);
+	_BitScanForward(&index, uint32_t(value >> 32));
+	return uint32_t(index) + 32;
+#else
+	return uint32_t(__builtin_ctzll(value));
+#endif
+}
+
+//! \brief Hints the processor to load the cache line holding \p p, never faults
+inline void Prefetch(const void* p) noexcept
+{
+#if defined(_M_X64) || defined(_M_IX86)
+	_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(_M_ARM64)
+	__prefetch(p);
+#else
+	__builtin_prefetch(p);
+#endif
+}
+
+//! \brief Returns the number of set bits
+inline uint32_t PopCount(uint64_t value) noexcept
+{
+#if defined(_M_ARM64)
+	return uint32_t(_CountOneBits64(value));
+#elif defined(_MSC_VER)
+	// __popcnt64 needs a 64-bit target and a processor with POPCNT, so the bits are summed in parallel instead
+	value = value - ((value >> 1) & 0x5555555555555555ULL);
+	value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+	value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return uint32_t((value * 0x0101010101010101ULL) >> 56);
+#else
+	return uint32_t(__builtin_popcountll(value));
+#endif
+}
+
+//! \brief Hints the processor, that the calling thread is spinning on a value written by another thread
+inline void CpuRelax() noexcept
+{
+#if defined(_M_X64) || defined(_M_IX86)
+	_mm_pause();
+#elif defined(_M_ARM64)
+	__yield();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+//! \brief Blocks while \p word holds \p value, until woken by NotifyWord or \p deadline, may return spuriously
+//! \details Windows and Linux park on the word also until a deadline (WaitOnAddress, futex). Elsewhere
+//!			 std::atomic::wait, which has no timeout, parks only waits without a deadline, and waits with a
+//!			 deadline (or without C++20 atomic waits) sleep in growing steps up to WAIT_MAX_SLEEP_US.
+inline void WaitOnWord(const std::atomic<uint32_t>& word,
+                       const uint32_t value,
+                       const std::chrono::steady_clock::time_point deadline) noexcept
+{
+	typedef std::chrono::steady_clock Clock;
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+	              "std::atomic<uint32_t> must have the layout of uint32_t");
+#if defined(_WIN32)
+	DWORD timeout = INFINITE;
+	if (deadline != Clock::time_point::max())
+	{
+		const Clock::time_point now = Clock::now();
+		if (now >= deadline)
+			return;
+		// Rounded up, so a waiter doesn't wake just before its deadline only to wait again
+		const auto ms = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+		timeout = ms < INFINITE ? DWORD(ms) : INFINITE - 1;
+	}
+	uint32_t compare = value;
+	WaitOnAddress(const_cast<std::atomic<uint32_t>*>(&word), &compare, sizeof(compare), timeout);
+#elif defined(__linux__)
+	timespec timeout{};
+	timespec* pTimeout = nullptr;
+	if (deadline != Clock::time_point::max())
+	{
+		const Clock::time_point now = Clock::now();
+		if (now >= deadline)
+			return;
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+		timeout.tv_sec = time_t(ns / 1000000000);
+		timeout.tv_nsec = long(ns % 1000000000);
+		pTimeout = &timeout;
+	}
+	syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, value, pTimeout, nullptr, 0);
+#else
+#if defined(__cpp_lib_atomic_wait)
+	if (deadline == Clock::time_point::max())
+	{
+		word.wait(value);
+		return;
+	}
+#endif
+	std::chrono::microseconds sleep(1);
+	for (auto now = Clock::now(); word.load() == value && now < deadline; now = Clock::now())
+	{
+		std::this_thread::sleep_for(std::min<Clock::duration>(sleep, deadline - now));
+		sleep = std::min(sleep * 2, std::chrono::microseconds(WAIT_MAX_SLEEP_US));
+	}
+#endif
+}
+
+//! \brief Wakes all threads parked in WaitOnWord on \p word
+inline void NotifyWord(std::atomic<uint32_t>& word) noexcept
+{
+#if defined(_WIN32)
+	WakeByAddressAll(&word);
+#elif defined(__linux__)
+	syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait)
+	word.notify_all();
+#else
+	(void)word;
+#endif
+}
+
+//! \brief Returns an atomic view of \p t, which is otherwise accessed as a plain object
+#if defined(__cpp_lib_atomic_ref)
+template <typename T>
+inline std::atomic_ref<T> AtomicRef(T& t) noexcept
+{
+	return std::atomic_ref<T>(t);
+}
+#else
+template <typename T>
+inline std::atomic<T>& AtomicRef(T& t) noexcept
+{
+	static_assert(sizeof(std::atomic<T>) == sizeof(T) && alignof(std::atomic<T>) == alignof(T),
+	              "std::atomic<T> must have the layout of T");
+	return *reinterpret_cast<std::atomic<T>*>(&t);
+}
+#endif